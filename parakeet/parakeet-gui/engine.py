@@ -52,6 +52,28 @@ class Engine:
         moves = [int(m) for m in output[0].split()]
         return moves
 
+    def legal_moves(self) -> dict:
+        """Returns every legal move in one go: {"moves": {origin square: [target squares]},
+        "check": "white"/"black"/None, "status": "ongoing"/"checkmate"/"stalemate"}.
+        Promotions show up once per piece, so targets can repeat."""
+        print("Sending $legalmoves")
+        self.analyzer.sendline("$legalmoves")
+        self.analyzer.expect(r"\$legalmoves[^\r\n]*")
+        words = self.analyzer.after.split()
+        self.skip()
+
+        square = lambda name: (ord(name[0]) - ord("a")) + 8 * (int(name[1]) - 1)
+        moves = {}
+        for move in words[words.index("moves") + 1:]:
+            moves.setdefault(square(move[0:2]), []).append(square(move[2:4]))
+
+        check = words[words.index("check") + 1]
+        return {
+            "moves": moves,
+            "check": None if check == "none" else check,
+            "status": words[words.index("status") + 1],
+        }
+
     def make_move(self, square:int):
         """Makes a move in Parakeet. Always call directly after suggest_move_square()! (for now)"""
         print("Sending", square)
@@ -61,8 +83,18 @@ class Engine:
     def last_communication(self):
         return self.analyzer.after
 
-    def play(self):
-        """Plays the best move according to the engine."""
+    def play(self, on_info=None):
+        """Plays the best move according to the engine. While it searches, on_info (if given) is
+        called with each progress line's fields, e.g. {"depth": "7", "score": "35", ..., "pv": "e4 e5"}."""
         print("Sending $play")
         self.analyzer.sendline("$play")
-        print(self.skip())
\ No newline at end of file
+        while self.analyzer.expect([r"\$info depth [^\r\n]* pv [^\r\n]*\n", r"\$Enter a move or command\r?\n> "], timeout=None) == 0:
+            line = self.analyzer.after.strip()
+            print(line)
+            if on_info is not None:
+                words, pv = line.split(" pv ", 1)
+                words = words.split()[1:]
+                info = dict(zip(words[0::2], words[1::2]))
+                info["pv"] = pv
+                on_info(info)
+        print(self.analyzer.before)
\ No newline at end of file
@@ -0,0 +1,86 @@
+import ctypes
+import os
+
+class Limits(ctypes.Structure):
+    _fields_ = [("depth", ctypes.c_int), ("nodes", ctypes.c_uint64)]
+
+class Result(ctypes.Structure):
+    _fields_ = [
+        ("best_move", ctypes.c_char * 8),
+        ("score", ctypes.c_int),
+        ("depth", ctypes.c_int),
+        ("nodes", ctypes.c_uint64),
+        ("time_ms", ctypes.c_double),
+    ]
+
+def _load(path: str):
+    lib = ctypes.CDLL(path)
+    lib.parakeet_new.restype = ctypes.c_void_p
+    lib.parakeet_free.argtypes = [ctypes.c_void_p]
+    lib.parakeet_new_game.argtypes = [ctypes.c_void_p]
+    lib.parakeet_set_position.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+    lib.parakeet_search.argtypes = [ctypes.c_void_p, ctypes.POINTER(Limits), ctypes.POINTER(Result)]
+    lib.parakeet_legal_moves.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.parakeet_get_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]
+    lib.parakeet_perft.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.parakeet_perft.restype = ctypes.c_int64
+    return lib
+
+class Library:
+    """Parakeet called in-process through its C API (parakeet.h), instead of through the REPL like engine.py.
+    Moves are in UCI notation (e2e4, e7e8q). The library is bin/parakeet.dll, which compile.bat builds, unless
+    library_path names another (on other systems, a shared library built from the same sources with -fPIC)."""
+
+    def __init__(self, library_path: str = None):
+        if library_path is None:
+            if os.name != "nt":
+                raise FileNotFoundError("compile.bat only builds bin/parakeet.dll: pass the path of a shared library "
+                                        "built from the sources on its first line with -shared -fPIC")
+            library_path = os.path.join(os.path.dirname(__file__), "..", "bin", "parakeet.dll")
+        self.lib = _load(library_path)
+        self.engine = self.lib.parakeet_new()
+        if not self.engine:
+            raise RuntimeError("Couldn't create engine")
+
+    def close(self):
+        if self.engine:
+            self.lib.parakeet_free(self.engine)
+            self.engine = None
+
+    def _check(self, code: int) -> int:
+        if code < 0:
+            raise ValueError(f"Parakeet error {code}")
+        return code
+
+    def new_game(self):
+        self._check(self.lib.parakeet_new_game(self.engine))
+
+    def set_position(self, fen: str = None, moves: list = ()):
+        """Sets up the FEN (the starting position if None) and plays the moves from it."""
+        self._check(self.lib.parakeet_set_position(
+            self.engine, fen.encode() if fen else None, " ".join(moves).encode()))
+
+    def search(self, depth: int = 0, nodes: int = 0) -> dict:
+        """Searches the position without playing a move. 0 means the default depth or no node limit."""
+        result = Result()
+        self._check(self.lib.parakeet_search(self.engine, ctypes.byref(Limits(depth, nodes)), ctypes.byref(result)))
+        return {
+            "best_move": result.best_move.decode(),
+            "score": result.score,
+            "depth": result.depth,
+            "nodes": result.nodes,
+            "time_ms": result.time_ms,
+        }
+
+    def legal_moves(self) -> list:
+        buffer = ctypes.create_string_buffer(2048)
+        self._check(self.lib.parakeet_legal_moves(self.engine, buffer, len(buffer)))
+        return buffer.value.decode().split()
+
+    def fen(self) -> str:
+        buffer = ctypes.create_string_buffer(128)
+        self._check(self.lib.parakeet_get_fen(self.engine, buffer, len(buffer)))
+        return buffer.value.decode()
+
+    def perft(self, depth: int) -> int:
+        return self._check(self.lib.parakeet_perft(self.engine, depth))
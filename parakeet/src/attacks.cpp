@@ -0,0 +1,113 @@
+#include "attacks.hpp"
+
+namespace {
+    using attacks::SquareList;
+
+    // file and rank steps for each Direction
+    constexpr int FILE_STEP[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+    constexpr int RANK_STEP[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+
+    constexpr bool onBoard(const int file, const int rank) {
+        return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+    }
+
+    constexpr std::array<SquareList, 64> generateJumps(const int (&steps)[8][2]) {
+        std::array<SquareList, 64> out{};
+        for (int square = 0; square < 64; square++) {
+            for (const auto& step : steps) {
+                const int file = square % 8 + step[0];
+                const int rank = square / 8 + step[1];
+                if (onBoard(file, rank)) out[square].add(rank * 8 + file);
+            }
+        }
+        return out;
+    }
+
+    // same order as the original runtime tables, which move ordering depends on
+    constexpr int KNIGHT_STEPS[8][2] = {{1, 2}, {-1, 2}, {2, 1}, {-2, 1}, {1, -2}, {-1, -2}, {2, -1}, {-2, -1}};
+    constexpr int KING_STEPS[8][2]   = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    constexpr std::array<std::array<SquareList, 64>, 2> generatePawnAttacks() {
+        std::array<std::array<SquareList, 64>, 2> out{};
+        for (int side = 0; side < 2; side++) {
+            const int forward = (side == 0) ? 1 : -1;
+            for (int square = 0; square < 64; square++) {
+                for (const int fileStep : {1, -1}) {
+                    const int file = square % 8 + fileStep;
+                    const int rank = square / 8 + forward;
+                    if (onBoard(file, rank)) out[side][square].add(rank * 8 + file);
+                }
+            }
+        }
+        return out;
+    }
+
+    constexpr std::array<std::array<SquareList, 64>, 8> generateRays() {
+        std::array<std::array<SquareList, 64>, 8> out{};
+        for (int direction = 0; direction < 8; direction++) {
+            for (int square = 0; square < 64; square++) {
+                int file = square % 8 + FILE_STEP[direction];
+                int rank = square / 8 + RANK_STEP[direction];
+                while (onBoard(file, rank)) {
+                    out[direction][square].add(rank * 8 + file);
+                    file += FILE_STEP[direction];
+                    rank += RANK_STEP[direction];
+                }
+            }
+        }
+        return out;
+    }
+
+    using RayTable = std::array<std::array<SquareList, 64>, 8>;
+
+    constexpr std::array<std::array<attacks::Direction, 64>, 64> generateDirections(const RayTable& rays) {
+        std::array<std::array<attacks::Direction, 64>, 64> out{};
+        for (auto& row : out)
+            for (auto& direction : row) direction = attacks::NONE;
+
+        for (int direction = 0; direction < 8; direction++) {
+            for (int from = 0; from < 64; from++) {
+                const SquareList& ray = rays[direction][from];
+                for (int i = 0; i < ray.count; i++) out[from][ray.squares[i]] = (attacks::Direction) direction;
+            }
+        }
+        return out;
+    }
+
+    constexpr std::array<std::array<uint64_t, 64>, 8> generateRayMasks(const RayTable& rays) {
+        std::array<std::array<uint64_t, 64>, 8> out{};
+        for (int direction = 0; direction < 8; direction++) {
+            for (int square = 0; square < 64; square++) {
+                const SquareList& ray = rays[direction][square];
+                for (int i = 0; i < ray.count; i++) out[direction][square] |= 1ULL << ray.squares[i];
+            }
+        }
+        return out;
+    }
+
+    constexpr std::array<std::array<uint64_t, 64>, 64> generateBetween(const RayTable& rays) {
+        std::array<std::array<uint64_t, 64>, 64> out{};
+        for (int direction = 0; direction < 8; direction++) {
+            for (int from = 0; from < 64; from++) {
+                const SquareList& ray = rays[direction][from];
+                uint64_t mask = 0;
+                for (int i = 0; i < ray.count; i++) {
+                    out[from][ray.squares[i]] = mask;
+                    mask |= 1ULL << ray.squares[i];
+                }
+            }
+        }
+        return out;
+    }
+}
+
+// constexpr, so all of this is done by the compiler and nothing is built at startup
+namespace attacks {
+    constexpr std::array<SquareList, 64> knightMoves = generateJumps(KNIGHT_STEPS);
+    constexpr std::array<SquareList, 64> kingMoves = generateJumps(KING_STEPS);
+    constexpr std::array<std::array<SquareList, 64>, 2> pawnAttacks = generatePawnAttacks();
+    constexpr std::array<std::array<SquareList, 64>, 8> rays = generateRays();
+    constexpr std::array<std::array<uint64_t, 64>, 8> rayMasks = generateRayMasks(rays);
+    constexpr std::array<std::array<Direction, 64>, 64> directionTo = generateDirections(rays);
+    constexpr std::array<std::array<uint64_t, 64>, 64> between = generateBetween(rays);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/* Move and attack tables for the move generator, all generated at compile time.
+ * Squares are numbered as on the board: a1 = 0, h1 = 7, a8 = 56.
+ */
+namespace attacks {
+    // A short list of squares stored inline, so looking one up is a single contiguous load
+    struct SquareList {
+        uint8_t count = 0;
+        std::array<uint8_t, 8> squares{};
+
+        constexpr void add(const int square) { squares[count++] = (uint8_t) square; }
+        const uint8_t* begin() const { return squares.data(); }
+        const uint8_t* end() const { return squares.data() + count; }
+    };
+
+    // Straight directions come before diagonal ones
+    enum Direction : uint8_t {
+        NORTH, SOUTH, EAST, WEST, NORTHEAST, NORTHWEST, SOUTHEAST, SOUTHWEST, NONE
+    };
+    constexpr bool isDiagonal(const int direction) { return direction >= NORTHEAST && direction < NONE; }
+    constexpr Direction opposite(const int direction) {
+        return (Direction) (direction < NORTHEAST ? direction ^ 1 : NORTHEAST + SOUTHWEST - direction);
+    }
+
+    extern const std::array<SquareList, 64> knightMoves;
+    extern const std::array<SquareList, 64> kingMoves;
+    // [side][square]: squares a pawn of that side attacks from the square (Side::WHITE = 0)
+    extern const std::array<std::array<SquareList, 64>, 2> pawnAttacks;
+    // [direction][square]: squares in that direction, nearest first, up to the edge of the board
+    extern const std::array<std::array<SquareList, 64>, 8> rays;
+    // [direction][square]: the squares of rays[direction][square] as a bit mask
+    extern const std::array<std::array<uint64_t, 64>, 8> rayMasks;
+    // [from][to]: direction from one square to the other, NONE if they aren't on a line
+    extern const std::array<std::array<Direction, 64>, 64> directionTo;
+    // [from][to]: bit mask of the squares strictly between two squares on a line, 0 otherwise
+    extern const std::array<std::array<uint64_t, 64>, 64> between;
+
+    // The square nearest the start of a ray out of squares (not 0) that are all on it
+    inline int nearest(const int direction, const uint64_t squares) {
+        const bool upwards = (direction == NORTH || direction == EAST || direction == NORTHEAST || direction == NORTHWEST);
+        return upwards ? __builtin_ctzll(squares) : 63 - __builtin_clzll(squares);
+    }
+
+    // Removes the lowest set bit from mask and returns its square
+    inline int popSquare(uint64_t& mask) {
+        const int square = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        return square;
+    }
+}
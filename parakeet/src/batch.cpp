@@ -0,0 +1,206 @@
+#include "batch.hpp"
+#include "engine.hpp"
+#include "utility.hpp"
+#include "log.hpp"
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <condition_variable>
+
+namespace batch {
+namespace {
+    struct Record {
+        size_t number;
+        std::string line;
+    };
+
+    struct Position {
+        std::string fen;
+        std::string id;
+        SearchLimits limits;
+    };
+
+    // FEN: placement side castling en-passant [halfmove fullmove]
+    // EPD: placement side castling en-passant [opcode operands;]...
+    bool parse(const std::string& line, Position& out, std::string& error) {
+        std::istringstream stream(line);
+        std::vector<std::string> fields(4);
+        for (std::string& field : fields) {
+            if (!(stream >> field)) {
+                error = "not enough fields";
+                return false;
+            }
+        }
+        out.fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+
+        Board board;
+        const char* fenError = nullptr;
+        if (!loadFEN(out.fen, board, &fenError)) {
+            error = fenError;
+            return false;
+        }
+
+        std::string rest;
+        std::getline(stream, rest);
+
+        std::string operation;
+        std::istringstream operations(rest);
+        while (std::getline(operations, operation, ';')) {
+            std::istringstream words(operation);
+            std::string opcode, operand;
+            if (!(words >> opcode)) continue;
+            std::getline(words >> std::ws, operand);
+
+            try {
+                if (opcode == "acd") out.limits.depth = std::stoi(operand);
+                else if (opcode == "acn") out.limits.nodes = std::stoull(operand);
+                else if (opcode == "id") {
+                    if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"')
+                        operand = operand.substr(1, operand.size() - 2);
+                    out.id = operand;
+                }
+            } catch (const std::exception&) {
+                error = "bad operand for " + opcode;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string analyse(Engine& engine, const Record& record, const SearchLimits& defaults, uint64_t& nodes) {
+        std::string prefix = "$result " + std::to_string(record.number);
+
+        Position position;
+        std::string error;
+        if (!parse(record.line, position, error)) return prefix + " error " + error;
+
+        if (position.limits.depth == 0 && position.limits.nodes == 0) position.limits = defaults;
+
+        engine.newGame();   // results shouldn't depend on which worker searched what before
+        loadFEN(position.fen, engine.board);
+
+        const auto start = std::chrono::steady_clock::now();
+        const SearchResult result = engine.analyse(position.limits);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        nodes = result.nodes;
+
+        std::ostringstream out;
+        out << prefix << " bestmove ";
+        if (result.bestMove.beforeAndAfterDifferent()) out << uci(result.bestMove);
+        else out << "none";
+        out << " score " << result.eval << " depth " << result.depth << " nodes " << result.nodes
+            << " time " << (int)ms;
+        if (!position.id.empty()) out << " id \"" << position.id << "\"";
+        return out.str();
+    }
+}
+
+int run(int argc, char* argv[]) {
+    std::string path;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    SearchLimits defaults;
+
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg.rfind("threads=", 0) == 0) threads = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("depth=", 0) == 0) defaults.depth = std::stoi(arg.substr(6));
+            else if (arg.rfind("nodes=", 0) == 0) defaults.nodes = std::stoull(arg.substr(6));
+            else path = arg;
+        } catch (const std::exception&) {
+            Log(LogLevel::ERROR, "Bad batch argument " + arg);
+            return 1;
+        }
+    }
+
+    std::ifstream file;
+    if (!path.empty()) {
+        file.open(path);
+        if (!file) {
+            Log(LogLevel::ERROR, "Couldn't open " + path);
+            return 1;
+        }
+    }
+    std::istream& input = path.empty() ? std::cin : file;
+
+    std::vector<std::unique_ptr<Engine>> engines;
+    for (unsigned int i = 0; i < threads; i++) engines.push_back(std::make_unique<Engine>());
+
+    std::mutex mutex;
+    std::condition_variable workAvailable, spaceAvailable;
+    std::deque<Record> queue;
+    bool finished = false;
+
+    // results wait here until everything before them has been written
+    std::mutex outputMutex;
+    std::map<size_t, std::string> pending;
+    size_t nextToWrite = 1;
+    uint64_t totalNodes = 0;
+
+    const auto worker = [&](Engine& engine) {
+        while (true) {
+            Record record;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                workAvailable.wait(lock, [&]() { return !queue.empty() || finished; });
+                if (queue.empty()) return;
+                record = std::move(queue.front());
+                queue.pop_front();
+            }
+            spaceAvailable.notify_one();
+
+            uint64_t nodes = 0;
+            std::string result = analyse(engine, record, defaults, nodes);
+
+            std::lock_guard<std::mutex> lock(outputMutex);
+            totalNodes += nodes;
+            pending[record.number] = std::move(result);
+            for (auto it = pending.begin(); it != pending.end() && it->first == nextToWrite; it = pending.erase(it)) {
+                std::cout << it->second << '\n';
+                nextToWrite++;
+            }
+            std::cout.flush();
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (auto& engine : engines) workers.emplace_back(worker, std::ref(*engine));
+
+    // read as we go, keeping only a few records per worker in memory
+    std::string line;
+    size_t number = 0;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.find_first_not_of(" \t") == std::string::npos || line[0] == '#') continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        spaceAvailable.wait(lock, [&]() { return queue.size() < 4 * engines.size(); });
+        queue.push_back({++number, line});
+        lock.unlock();
+        workAvailable.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    workAvailable.notify_all();
+
+    for (std::thread& thread : workers) thread.join();
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "$batch positions " << number << " threads " << engines.size() << " nodes " << totalNodes
+              << " time " << (int)ms << " ms nps " << (uint64_t)(totalNodes / std::max(ms, 1.0) * 1000) << std::endl;
+    return 0;
+}
+}
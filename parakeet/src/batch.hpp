@@ -0,0 +1,14 @@
+#pragma once
+
+/* Batch analysis: parakeet batch [file] [threads=N] [depth=N] [nodes=N]
+ *
+ * Reads one FEN or EPD record per line from the file (stdin if none is given) and searches them on
+ * a pool of worker threads, each with its own Engine. For every record a line
+ *     $result <record number> bestmove <move (UCI)> score <eval> depth <plies> nodes <n> time <ms> [id "<id>"]
+ * is written, in the order of the input. EPD records can set their own limits with the acd (depth)
+ * and acn (nodes) opcodes, and an id opcode is passed through.
+ */
+namespace batch {
+    // argv without the program name and "batch". Returns the exit code.
+    int run(int argc, char* argv[]);
+}
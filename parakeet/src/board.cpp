@@ -1,31 +1,33 @@
 #include "board.hpp"
 #include "log.hpp"
 #include "timer.hpp"
+#include "zobrist.hpp"
+#include "attacks.hpp"
 
 #include <cassert>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-#define WITHIN_BOUNDS(c)    c.x >= 0 && c.x < 8 && c.y >= 0 && c.y < 8
-#define COORD_TO_SQUARE(c)  c.y * 8 + c.x
-#define SQUARE_TO_COORD(sq) {sq%8, sq/8}
-
-std::unordered_map<PieceType, int>* Board::pieceValues_ptr;
-std::array<std::vector<int>, 64> Board::knightAttacksAtSquare;
-std::array<std::vector<int>, 64> Board::kingMovesAtSquare;
-
-
-namespace dirs {
-    constexpr Coordinate south      (Coordinate c)   { return {c.x, c.y-1};   }
-    constexpr Coordinate north      (Coordinate c)   { return {c.x, c.y+1};   }
-    constexpr Coordinate east       (Coordinate c)   { return {c.x+1, c.y};   }
-    constexpr Coordinate west       (Coordinate c)   { return {c.x-1, c.y};   }
-    constexpr Coordinate northeast  (Coordinate c)   { return {c.x+1, c.y+1}; }
-    constexpr Coordinate southeast  (Coordinate c)   { return {c.x+1, c.y-1}; }
-    constexpr Coordinate northwest  (Coordinate c)   { return {c.x-1, c.y+1}; }
-    constexpr Coordinate southwest  (Coordinate c)   { return {c.x-1, c.y-1}; }
-};
+uint64_t AttackMaps::squares(const Side side) const {
+    constexpr uint64_t LOW_BITS = 0x7F7F7F7F7F7F7F7Full;
+    constexpr uint64_t HIGH_BITS = 0x8080808080808080ull;
 
+    // eight counts at a time: the top bit of each byte is set if the count isn't 0, and the
+    // multiplication gathers those bits into the top byte
+    uint64_t out = 0;
+    for (int i = 0; i < 8; i++) {
+        uint64_t eight;
+        std::memcpy(&eight, counts[(int)side].data() + 8*i, 8);
+        const uint64_t nonZero = (((eight & LOW_BITS) + LOW_BITS) | eight) & HIGH_BITS;
+        out |= ((nonZero >> 7) * 0x0102040810204080ull >> 56) << (8*i);
+    }
+    return out;
+}
 
 Board::Board() {
+    position.fill(EMPTY_SQUARE);    // an empty board until reset() or setUp(), so the material can be counted
+
     castlingRightsKingSide[Side::WHITE]  = true;    castlingRightsKingSide[Side::BLACK]  = true;
     castlingRightsQueenSide[Side::WHITE] = true;    castlingRightsQueenSide[Side::BLACK] = true;
 
@@ -36,127 +38,295 @@ Board::Board() {
     lastDoublePawnPush = 64;
 
     materialDifference = 0;
+    materialKey = 0;
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+    hash = 0;
 }
 
-// inefficient!! only use when time is unimportant
-Board::Board(std::array<Piece, 64>& position, Side sideToPlay,
+void Board::setUp(const std::array<Piece, 64>& newPosition, const Side newSideToPlay,
     bool whiteCanCastleKingSide, bool whiteCanCastleQueenSide, bool blackCanCastleKingSide, bool blackCanCastleQueenSide,
-    bool enPassantPossible, unsigned short lastDoublePawnPush, int materialDifference)
-    : position(position), sideToPlay(sideToPlay), enPassantPossible(enPassantPossible),
-        lastDoublePawnPush(lastDoublePawnPush), materialDifference(materialDifference)
-{
+    bool newEnPassantPossible, unsigned short newLastDoublePawnPush, int newHalfmoveClock, int newFullmoveNumber) {
+
+    position = newPosition;
+    sideToPlay = newSideToPlay;
+    enPassantPossible = newEnPassantPossible;
+    lastDoublePawnPush = newLastDoublePawnPush;
+    halfmoveClock = newHalfmoveClock;
+    fullmoveNumber = newFullmoveNumber;
+
     castlingRightsKingSide[Side::WHITE]  = whiteCanCastleKingSide;
     castlingRightsKingSide[Side::BLACK]  = blackCanCastleKingSide;
     castlingRightsQueenSide[Side::WHITE] = whiteCanCastleQueenSide;
     castlingRightsQueenSide[Side::BLACK] = blackCanCastleQueenSide;
 
+    occupied = 0;
     for (int square = 0; square < 64; square++) {
-        if (position[square].type == PieceType::KING) {
-            kingsData.positions[position[square].side] = square;
-            kingsData.knightAttacks[position[square].side] = &knightAttacksAtSquare[square];
-        }
+        if (position[square].type != PieceType::EMPTY) occupied |= 1ULL << square;
+        if (position[square].type == PieceType::KING) kingsData.positions[position[square].side] = square;
     }
+    materialDifference = computeMaterialDifference();
+    materialKey = computeMaterialKey();
+    attackMaps = computeAttackMaps();
 
     check[Side::WHITE] = sideInCheck(Side::WHITE);
     check[Side::BLACK] = sideInCheck(Side::BLACK);
+
+    hash = computeHash();
 }
 
-void Board::setPieceValues(std::unordered_map<PieceType, int>& pieceValues) {
-    pieceValues_ptr = &pieceValues;
+void Board::setPieceValues(const PieceValues& values) {
+    pieceValues = &values;
+}
+
+PackedPosition Board::pack() const {
+    PackedPosition packed = {};
+
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        const Piece& piece = position[square];
+        if (piece.type == PieceType::EMPTY) continue;
+
+        const uint8_t code = (uint8_t) piece.type | (piece.side == Side::BLACK ? 8 : 0);
+        packed.occupancy |= 1ULL << square;
+        packed.pieces[count / 2] |= (count % 2 == 0) ? code : code << 4;
+        count++;
+    }
+
+    if (sideToPlay == Side::BLACK)              packed.flags |= PackedPosition::BLACK_TO_PLAY;
+    if (castlingRightsKingSide.at(Side::WHITE))  packed.flags |= PackedPosition::WHITE_KING_SIDE;
+    if (castlingRightsQueenSide.at(Side::WHITE)) packed.flags |= PackedPosition::WHITE_QUEEN_SIDE;
+    if (castlingRightsKingSide.at(Side::BLACK))  packed.flags |= PackedPosition::BLACK_KING_SIDE;
+    if (castlingRightsQueenSide.at(Side::BLACK)) packed.flags |= PackedPosition::BLACK_QUEEN_SIDE;
+
+    packed.enPassant = enPassantCapturePossible() ? lastDoublePawnPush : 64;
+    packed.halfmoveClock = (uint8_t) std::min(std::max(halfmoveClock, 0), 255);
+    packed.result = PackedPosition::NO_RESULT;
+    packed.fullmoveNumber = (uint16_t) std::min(std::max(fullmoveNumber, 1), 65535);
+    packed.score = PackedPosition::NO_SCORE;
+    return packed;
+}
+
+bool Board::unpack(const PackedPosition& packed) {
+    if (__builtin_popcountll(packed.occupancy) > 32) return false;
+
+    std::array<Piece, 64> newPosition;
+    newPosition.fill(EMPTY_SQUARE);
+
+    int kings[2] = {0, 0};
+    int count = 0;
+    for (uint64_t occupied = packed.occupancy; occupied != 0; count++) {
+        const int square = attacks::popSquare(occupied);
+        const uint8_t code = (packed.pieces[count / 2] >> (count % 2 * 4)) & 15;
+
+        const int type = code & 7;
+        if (type == (int) PieceType::EMPTY || type > (int) PieceType::PAWN) return false;
+
+        const Piece piece = {(PieceType) type, (code & 8) ? Side::BLACK : Side::WHITE};
+        if (piece.type == PieceType::PAWN && (square < 8 || square >= 56)) return false;
+        if (piece.type == PieceType::KING) kings[(int) piece.side]++;
+        newPosition[square] = piece;
+    }
+    if (kings[0] != 1 || kings[1] != 1 || packed.enPassant > 64) return false;
+
+    const Side newSideToPlay = (packed.flags & PackedPosition::BLACK_TO_PLAY) ? Side::BLACK : Side::WHITE;
+    if (packed.enPassant < 64) {
+        // has to be the opponent's pawn, just after its double push
+        const Piece& pawn = newPosition[packed.enPassant];
+        const int rank = (newSideToPlay == Side::WHITE) ? 4 : 3;
+        if (pawn.type != PieceType::PAWN || pawn.side == newSideToPlay || packed.enPassant / 8 != rank) return false;
+    }
+
+    setUp(
+        newPosition, newSideToPlay,
+        packed.flags & PackedPosition::WHITE_KING_SIDE, packed.flags & PackedPosition::WHITE_QUEEN_SIDE,
+        packed.flags & PackedPosition::BLACK_KING_SIDE, packed.flags & PackedPosition::BLACK_QUEEN_SIDE,
+        packed.enPassant < 64, packed.enPassant, packed.halfmoveClock, std::max<int>(packed.fullmoveNumber, 1)
+    );
+    return true;
 }
 
 void Board::makeMove(const Move& move) {
+    if (position[move.before].side == Side::WHITE) makeMoveFor<Side::WHITE>(move);
+    else makeMoveFor<Side::BLACK>(move);
+}
+
+template <Side us>
+void Board::makeMoveFor(const Move& move) {
     //Timer timer;
+    constexpr Side them = opponentOf(us);
+    constexpr int plusMinus = (us == Side::WHITE) ? 1 : -1;
+    constexpr int forwardOffset = (us == Side::WHITE) ? 8 : -8;
+
+    // rook squares whose rights go when something moves from (ours) or to (theirs) them
+    constexpr int ourKingSideRook    = (us == Side::WHITE) ? 7 : 63;
+    constexpr int ourQueenSideRook   = (us == Side::WHITE) ? 0 : 56;
+    constexpr int theirKingSideRook  = (us == Side::WHITE) ? 63 : 7;
+    constexpr int theirQueenSideRook = (us == Side::WHITE) ? 56 : 0;
+
     Piece piece = position[move.before];    // has to be by value (no pointer!)
 
+    if (piece.type == PieceType::PAWN || move.capture) halfmoveClock = 0;
+    else halfmoveClock++;
+    if (us == Side::BLACK) fullmoveNumber++;
+
+    hash ^= castlingAndEnPassantKey();  // taken out here and put back in at the end
+    hash ^= zobrist::pieceKey(piece, move.before);
+    if (move.capture && !move.isEnPassant())
+        hash ^= zobrist::pieceKey(position[move.after], move.after);
+
     if (move.capture) {
-        const int plusMinus = (piece.side==Side::WHITE) ? 1 : -1;
-        if (move.isEnPassant())
-            materialDifference += plusMinus * (*pieceValues_ptr).at(PieceType::PAWN);
-        else {
-            try {
-                materialDifference += plusMinus * (*pieceValues_ptr).at(position[move.after].type);
-            } catch (std::out_of_range) {
-                
-            }
+        if (move.isEnPassant()) {
+            materialDifference += plusMinus * (*pieceValues)[PieceType::PAWN];
+            materialKey -= material::unit({PieceType::PAWN, them});
+        } else {
+            materialKey -= material::unit(position[move.after]);
+            materialDifference += plusMinus * (*pieceValues)[position[move.after].type];
         }
     }
 
     if (enPassantPossible) enPassantPossible = false;
 
     if (move.promotion) {
-        const int plusMinus = (piece.side==Side::WHITE) ? 1 : -1;
-        materialDifference -= plusMinus * pieceValues_ptr->at(PieceType::PAWN);
+        materialDifference -= plusMinus * (*pieceValues)[PieceType::PAWN];
+        materialKey -= material::unit(piece);
 
         if (move.special1 && move.special0) { // queen-promotion
             piece.type = PieceType::QUEEN;
-            materialDifference += plusMinus * pieceValues_ptr->at(PieceType::QUEEN);
+            materialDifference += plusMinus * (*pieceValues)[PieceType::QUEEN];
         } else if (move.special1 && !move.special0) { // rook-promotion
             piece.type = PieceType::ROOK;
-            materialDifference += plusMinus * pieceValues_ptr->at(PieceType::ROOK);
+            materialDifference += plusMinus * (*pieceValues)[PieceType::ROOK];
         } else if (!move.special1 && move.special0) { // bishop-promotion
             piece.type = PieceType::BISHOP;
-            materialDifference += plusMinus * pieceValues_ptr->at(PieceType::BISHOP);
+            materialDifference += plusMinus * (*pieceValues)[PieceType::BISHOP];
         } else if (!move.special1 && !move.special0) { // knight-promotion
             piece.type = PieceType::KNIGHT;
-            materialDifference += plusMinus * pieceValues_ptr->at(PieceType::KNIGHT);
-        }
-    } else if (move.capture) {
-        if (move.special0) { // en passant
-            if (piece.side == Side::WHITE) {
-                position[move.after-8] = EMPTY_SQUARE;
-            } else {
-                position[move.after+8] = EMPTY_SQUARE;
-            }
+            materialDifference += plusMinus * (*pieceValues)[PieceType::KNIGHT];
         }
-    } else {
+        materialKey += material::unit(piece);
+    }
+
+    movePiece(move.before, move.after, piece);
+
+    if (move.isEnPassant()) {
+        const int capturedSquare = move.after - forwardOffset;
+        hash ^= zobrist::pieceKey(position[capturedSquare], capturedSquare);
+        removePiece(capturedSquare);
+    } else if (!move.capture && !move.promotion) {
         if (!move.special1 && move.special0) { // double pawn push
             enPassantPossible = true;
             lastDoublePawnPush = move.after;
         } else if (move.special1 && !move.special0) { // king-side castle
-            position[move.after-1] = {PieceType::ROOK, piece.side};
-            position[move.after+1] = EMPTY_SQUARE;
+            const Piece rook = {PieceType::ROOK, us};
+            movePiece(move.after+1, move.after-1, rook);
+            hash ^= zobrist::pieceKey(rook, move.after+1) ^ zobrist::pieceKey(rook, move.after-1);
         } else if (move.special1 && move.special0) { // queen-side castle
-            position[move.after+1] = {PieceType::ROOK, piece.side};
-            position[move.after-2] = EMPTY_SQUARE;
+            const Piece rook = {PieceType::ROOK, us};
+            movePiece(move.after-2, move.after+1, rook);
+            hash ^= zobrist::pieceKey(rook, move.after-2) ^ zobrist::pieceKey(rook, move.after+1);
         }
     }
 
     if (piece.type == PieceType::KING) {
         // update king things
-        kingsData.positions[piece.side] = move.after;
-        kingsData.knightAttacks.at(piece.side) = &knightAttacksAtSquare[move.after];
+        kingsData.positions[us] = move.after;
 
         // castling rights
-        if (castlingRightsKingSide.at(piece.side))
-            castlingRightsKingSide[piece.side] = false;
-        if (castlingRightsQueenSide.at(piece.side))
-            castlingRightsQueenSide[piece.side] = false;
+        castlingRightsKingSide[us] = false;
+        castlingRightsQueenSide[us] = false;
+    }
+
+    if (move.before == ourQueenSideRook) castlingRightsQueenSide[us] = false;
+    else if (move.before == ourKingSideRook) castlingRightsKingSide[us] = false;
+
+    if (move.after == theirQueenSideRook) castlingRightsQueenSide[them] = false;
+    else if (move.after == theirKingSideRook) castlingRightsKingSide[them] = false;
+
+    sideToPlay = them;
 
+    hash ^= zobrist::pieceKey(piece, move.after);
+    hash ^= castlingAndEnPassantKey();
+    hash ^= zobrist::keys[zobrist::TURN_OFFSET];
+    
+    check[them] = attacked(us, kingsData.positions[them]);
+    check[us] = false;  // you can't move so that you will be in check (implemented during move gen)
+}
+
+template <typename F>
+void Board::forEachAttack(const int square, F&& f) const {
+    const Piece& piece = position[square];
+
+    const auto slide = [&](const int firstDirection, const int lastDirection) {
+        for (int direction = firstDirection; direction <= lastDirection; direction++) {
+            for (const int target : attacks::rays[direction][square]) {
+                f(target);
+                if (position[target].type != PieceType::EMPTY) break;
+            }
+        }
+    };
+
+    switch (piece.type) {
+        case PieceType::EMPTY:  break;
+        case PieceType::KING:   for (const int target : attacks::kingMoves[square]) f(target); break;
+        case PieceType::KNIGHT: for (const int target : attacks::knightMoves[square]) f(target); break;
+        case PieceType::PAWN:   for (const int target : attacks::pawnAttacks[(int)piece.side][square]) f(target); break;
+        case PieceType::ROOK:   slide(attacks::NORTH, attacks::WEST); break;
+        case PieceType::BISHOP: slide(attacks::NORTHEAST, attacks::SOUTHWEST); break;
+        case PieceType::QUEEN:  slide(attacks::NORTH, attacks::SOUTHWEST); break;
     }
+}
+
+void Board::updatePieceAttacks(const int square, const int sign) {
+    const int side = (int) position[square].side;
+    auto& counts = attackMaps.counts[side];
+    forEachAttack(square, [&](const int target) { counts[target] += sign; });
+}
 
-    if (piece.side == Side::WHITE) {
-        if (move.before == 0) castlingRightsQueenSide[Side::WHITE] = false;
-        else if (move.before == 7) castlingRightsKingSide[Side::WHITE] = false;
+void Board::updateLinesThrough(const int square, const int sign) {
+    // a slider whose line runs through the square attacks it
+    if (!attacked(Side::WHITE, square) && !attacked(Side::BLACK, square)) return;
 
-        if (move.after == 56) castlingRightsQueenSide[Side::BLACK] = false;
-        else if (move.after == 63) castlingRightsKingSide[Side::BLACK] = false;
+    for (int direction = 0; direction < 8; direction++) {
+        const PieceType slider = attacks::isDiagonal(direction) ? PieceType::BISHOP : PieceType::ROOK;
 
-    } else {
-        if (move.before == 56) castlingRightsQueenSide[Side::BLACK] = false;
-        else if (move.before == 63) castlingRightsKingSide[Side::BLACK] = false;
+        // the first piece behind the square, seen from the direction the line goes on in
+        const int back = attacks::opposite(direction);
+        const uint64_t behind = attacks::rayMasks[back][square] & occupied;
+        if (behind == 0) continue;
+
+        const Piece& piece = position[attacks::nearest(back, behind)];
+        if (piece.type != PieceType::QUEEN && piece.type != slider) continue;
 
-        if (move.after == 0) castlingRightsQueenSide[Side::WHITE] = false;
-        else if (move.after == 7) castlingRightsKingSide[Side::WHITE] = false;
+        for (const int target : attacks::rays[direction][square]) {
+            attackMaps.counts[(int) piece.side][target] += sign;
+            if (occupied & (1ULL << target)) break;
+        }
     }
+}
 
-    position[move.after] = piece;
-    position[move.before] = EMPTY_SQUARE;
+void Board::movePiece(const int from, const int to, const Piece& piece) {
+    updatePieceAttacks(from, -1);
+    position[from] = EMPTY_SQUARE;
+    occupied &= ~(1ULL << from);
+    updateLinesThrough(from, 1);
 
-    sideToPlay = (sideToPlay == Side::WHITE) ? Side::BLACK : Side::WHITE;
-    
-    check[sideToPlay] = move.willBeCheck;
-    check[piece.side] = false;  // you can't move so that you will be in check (implemented during move gen)
+    if (position[to].type != PieceType::EMPTY) {
+        updatePieceAttacks(to, -1);     // the lines through it stay blocked
+        position[to] = piece;
+    } else {
+        position[to] = piece;
+        occupied |= 1ULL << to;
+        updateLinesThrough(to, -1);
+    }
+    updatePieceAttacks(to, 1);
+}
+
+void Board::removePiece(const int square) {
+    updatePieceAttacks(square, -1);
+    position[square] = EMPTY_SQUARE;
+    occupied &= ~(1ULL << square);
+    updateLinesThrough(square, 1);
 }
 
 void Board::reset() {
@@ -184,30 +354,116 @@ void Board::reset() {
 
     kingsData.positions[Side::WHITE] = 4; 
     kingsData.positions[Side::BLACK] = 60;
-
-    //Log(LogLevel::DEBUG, "line 154&155");
-    kingsData.knightAttacks[Side::WHITE] = &knightAttacksAtSquare[kingsData.positions.at(Side::WHITE)];
-    kingsData.knightAttacks[Side::BLACK] = &knightAttacksAtSquare[kingsData.positions.at(Side::BLACK)];
+    occupied = 0xFFFF00000000FFFFull;
 
     castlingRightsKingSide[Side::WHITE]  = true;    castlingRightsKingSide[Side::BLACK]  = true;
     castlingRightsQueenSide[Side::WHITE] = true;    castlingRightsQueenSide[Side::BLACK] = true;
     enPassantPossible = false;
     lastDoublePawnPush = 64;
     sideToPlay = Side::WHITE;
+
+    check[Side::WHITE] = false; check[Side::BLACK] = false;
+    materialDifference = 0;
+    materialKey = computeMaterialKey();
+    attackMaps = computeAttackMaps();
+    halfmoveClock = 0;
+    fullmoveNumber = 1;
+
+    hash = computeHash();
+}
+
+int Board::computeMaterialDifference() const {
+    int out = 0;
+    for (const Piece& piece : position) {
+        if (piece.type == PieceType::EMPTY || piece.type == PieceType::KING) continue;
+        out += (piece.side == Side::WHITE ? 1 : -1) * (*pieceValues)[piece.type];
+    }
+    return out;
+}
+
+uint64_t Board::computeMaterialKey() const {
+    uint64_t out = 0;
+    for (const Piece& piece : position) out += material::unit(piece);
+    return out;
+}
+
+AttackMaps Board::computeAttackMaps() const {
+    AttackMaps out;
+    for (int square = 0; square < 64; square++) {
+        const int side = (int) position[square].side;
+        forEachAttack(square, [&](const int target) { out.counts[side][target]++; });
+    }
+    return out;
+}
+
+uint64_t Board::computeHash() const {
+    uint64_t out = 0;
+    for (int square = 0; square < 64; square++) {
+        if (position[square].type != PieceType::EMPTY)
+            out ^= zobrist::pieceKey(position[square], square);
+    }
+
+    out ^= castlingAndEnPassantKey();
+    if (sideToPlay == Side::WHITE) out ^= zobrist::keys[zobrist::TURN_OFFSET];
+
+    return out;
+}
+
+uint64_t Board::castlingAndEnPassantKey() const {
+    uint64_t out = 0;
+    if (castlingRightsKingSide.at(Side::WHITE))  out ^= zobrist::keys[zobrist::CASTLING_OFFSET];
+    if (castlingRightsQueenSide.at(Side::WHITE)) out ^= zobrist::keys[zobrist::CASTLING_OFFSET+1];
+    if (castlingRightsKingSide.at(Side::BLACK))  out ^= zobrist::keys[zobrist::CASTLING_OFFSET+2];
+    if (castlingRightsQueenSide.at(Side::BLACK)) out ^= zobrist::keys[zobrist::CASTLING_OFFSET+3];
+
+    if (enPassantCapturePossible())
+        out ^= zobrist::keys[zobrist::EN_PASSANT_OFFSET + lastDoublePawnPush%8];
+
+    return out;
+}
+
+bool Board::enPassantCapturePossible() const {
+    if (!enPassantPossible || lastDoublePawnPush >= 64) return false;
+
+    const Piece ownPawn = {PieceType::PAWN, sideToPlay};
+    const auto isOwnPawn = [&](const int square) {
+        return position[square].type == ownPawn.type && position[square].side == ownPawn.side;
+    };
+
+    const int file = lastDoublePawnPush % 8;
+    if (file > 0 && isOwnPawn(lastDoublePawnPush-1)) return true;
+    if (file < 7 && isOwnPawn(lastDoublePawnPush+1)) return true;
+    return false;
 }
 
 void Board::generateMoves(const unsigned short square, std::vector<Move>& moves) const {    
-    //Timer timer;
-    const Piece& piece = position[square];
-    if (piece.side != sideToPlay) {
+    if (position[square].side != sideToPlay) {
         return;
     }
 
-    //Log(LogLevel::DEBUG, "Generating moves");
+    if (sideToPlay == Side::WHITE) generateMovesFor<Side::WHITE>(square, moves);
+    else generateMovesFor<Side::BLACK>(square, moves);
+}
 
-    Side opponent = (piece.side == Side::WHITE) ? Side::BLACK : Side::WHITE;
+void Board::generateAllMoves(std::vector<Move>& moves) const {
+    if (sideToPlay == Side::WHITE) generateAllMovesFor<Side::WHITE>(moves);
+    else generateAllMovesFor<Side::BLACK>(moves);
+}
 
-    const Coordinate c = SQUARE_TO_COORD(square);
+template <Side us>
+void Board::generateAllMovesFor(std::vector<Move>& moves) const {
+    for (int square = 0; square < 64; square++) {
+        if (position[square].side == us) generateMovesFor<us>(square, moves);
+    }
+}
+
+template <Side us>
+void Board::generateMovesFor(const int square, std::vector<Move>& moves) const {
+    //Timer timer;
+    //Log(LogLevel::DEBUG, "Generating moves");
+
+    constexpr Side opponent = opponentOf(us);
+    const Piece& piece = position[square];
 
     switch(piece.type) {
         case PieceType::EMPTY:
@@ -215,27 +471,20 @@ void Board::generateMoves(const unsigned short square, std::vector<Move>& moves)
 
         case PieceType::KING: {
             // king moves
-            for (const int& newSquare : kingMovesAtSquare[square]) {
+            for (const int newSquare : attacks::kingMoves[square]) {
                 if (position[newSquare].type == PieceType::EMPTY) {
-                    addMoveIfAcceptable(moves, {square, newSquare}, opponent, true, false);
+                    addMoveIfAcceptable<us>(moves, {square, newSquare}, true, false);
                 } else if (position[newSquare].side == opponent) {
-                    addMoveIfAcceptable(moves, {square, newSquare, true}, opponent, true, false);
+                    addMoveIfAcceptable<us>(moves, {square, newSquare, true}, true, false);
                 }
             }
 
-            if (!check.at(piece.side)) {
-                if (castlingRightsKingSide.at(piece.side)
-                    && position[square+1].type == PieceType::EMPTY
-                    && position[square+2].type == PieceType::EMPTY) {
-                    
-                    addMoveIfAcceptable(moves, {square, square+2, false, false, true, false}, opponent, true); // king-side castle
+            if (!check.at(us)) {
+                if (castlingRightsKingSide.at(us) && emptyBetween(square, square+3)) {
+                    addMoveIfAcceptable<us>(moves, {square, square+2, false, false, true, false}, true); // king-side castle
                 }
-                if (castlingRightsQueenSide.at(piece.side) 
-                    && position[square-1].type == PieceType::EMPTY
-                    && position[square-2].type == PieceType::EMPTY
-                    && position[square-3].type == PieceType::EMPTY) {
-
-                    addMoveIfAcceptable(moves, {square, square-2, false, false, true, true}, opponent, true); // queen-side castle
+                if (castlingRightsQueenSide.at(us) && emptyBetween(square, square-4)) {
+                    addMoveIfAcceptable<us>(moves, {square, square-2, false, false, true, true}, true); // queen-side castle
                 }
             }
 
@@ -243,215 +492,178 @@ void Board::generateMoves(const unsigned short square, std::vector<Move>& moves)
 
         case PieceType::QUEEN: {
             // queen moves
-            generateMovesInDirection(c, square, dirs::north,     moves, opponent);
-            generateMovesInDirection(c, square, dirs::south,     moves, opponent);
-            generateMovesInDirection(c, square, dirs::east,      moves, opponent);
-            generateMovesInDirection(c, square, dirs::west,      moves, opponent);
-
-            generateMovesInDirection(c, square, dirs::southeast, moves, opponent);
-            generateMovesInDirection(c, square, dirs::northeast, moves, opponent);
-            generateMovesInDirection(c, square, dirs::northwest, moves, opponent);
-            generateMovesInDirection(c, square, dirs::southwest, moves, opponent);
+            generateMovesInDirection<us>(square, attacks::NORTH,     moves);
+            generateMovesInDirection<us>(square, attacks::SOUTH,     moves);
+            generateMovesInDirection<us>(square, attacks::EAST,      moves);
+            generateMovesInDirection<us>(square, attacks::WEST,      moves);
+
+            generateMovesInDirection<us>(square, attacks::SOUTHEAST, moves);
+            generateMovesInDirection<us>(square, attacks::NORTHEAST, moves);
+            generateMovesInDirection<us>(square, attacks::NORTHWEST, moves);
+            generateMovesInDirection<us>(square, attacks::SOUTHWEST, moves);
         } break;
 
         case PieceType::BISHOP: {
             // bishop moves
-            generateMovesInDirection(c, square, dirs::northeast, moves, opponent);
-            generateMovesInDirection(c, square, dirs::southeast, moves, opponent);
-            generateMovesInDirection(c, square, dirs::northwest, moves, opponent);
-            generateMovesInDirection(c, square, dirs::southwest, moves, opponent);
+            generateMovesInDirection<us>(square, attacks::NORTHEAST, moves);
+            generateMovesInDirection<us>(square, attacks::SOUTHEAST, moves);
+            generateMovesInDirection<us>(square, attacks::NORTHWEST, moves);
+            generateMovesInDirection<us>(square, attacks::SOUTHWEST, moves);
         } break;
 
         case PieceType::KNIGHT: {
             // knight moves
-            for (const int& newSquare : knightAttacksAtSquare[square]) {
+            for (const int newSquare : attacks::knightMoves[square]) {
                 if (position[newSquare].type == PieceType::EMPTY) {
-                    addMoveIfAcceptable(moves, {square, newSquare}, opponent, false, true);
+                    addMoveIfAcceptable<us>(moves, {square, newSquare}, false, true);
                 } else if (position[newSquare].side == opponent) {
-                    addMoveIfAcceptable(moves, {square, newSquare, true}, opponent, false, true);
+                    addMoveIfAcceptable<us>(moves, {square, newSquare, true}, false, true);
                 }
             }
         } break;
 
         case PieceType::ROOK: {
             // rook moves
-            generateMovesInDirection(c, square, dirs::north,    moves, opponent);
-            generateMovesInDirection(c, square, dirs::south,    moves, opponent);
-            generateMovesInDirection(c, square, dirs::east,     moves, opponent);
-            generateMovesInDirection(c, square, dirs::west,     moves, opponent);
+            generateMovesInDirection<us>(square, attacks::NORTH,    moves);
+            generateMovesInDirection<us>(square, attacks::SOUTH,    moves);
+            generateMovesInDirection<us>(square, attacks::EAST,     moves);
+            generateMovesInDirection<us>(square, attacks::WEST,     moves);
         } break;
         case PieceType::PAWN: {
             // pawn moves
-            int forwardOffset;
-
-            bool squareBeforeLastTwoRanks;
-            unsigned short homeRank;
-            unsigned short enPassantRank;
-
-            if (piece.side == Side::WHITE) {
-                forwardOffset = 8;
-                squareBeforeLastTwoRanks = (square < 48);
-                homeRank = 1;
-                enPassantRank = 4;
-            } else {
-                forwardOffset = -8;
-                squareBeforeLastTwoRanks = (square > 15);
-                homeRank = 6;
-                enPassantRank = 3;
-            }
+            constexpr int forwardOffset = (us == Side::WHITE) ? 8 : -8;
+            constexpr int homeRank = (us == Side::WHITE) ? 1 : 6;
+            constexpr int enPassantRank = (us == Side::WHITE) ? 4 : 3;
+
+            const bool squareBeforeLastTwoRanks = (us == Side::WHITE) ? (square < 48) : (square > 15);
 
             if (position[square+forwardOffset].type == PieceType::EMPTY) {
                 if (squareBeforeLastTwoRanks) {
                     const Move move = {square, square+forwardOffset};
-                    addMoveIfAcceptable(moves, move, opponent);   // single pawn push
+                    addMoveIfAcceptable<us>(moves, move);   // single pawn push
                     if (square / 8 == homeRank && position[square+forwardOffset*2].type == PieceType::EMPTY) {
-                        addMoveIfAcceptable(moves, {square, square+forwardOffset*2, 0, 0, 0, 1}, opponent); // double pawn push
+                        addMoveIfAcceptable<us>(moves, {square, square+forwardOffset*2, 0, 0, 0, 1}); // double pawn push
                     }
                 } else {
                     // promotions
-                    addAllPromotionsIfAcceptable(moves, {square, square+forwardOffset, 0}, opponent);
+                    addAllPromotionsIfAcceptable<us>(moves, {square, square+forwardOffset, 0});
                 }
             }
             // captures
             // right
-            if (c.x < 7 && square+forwardOffset+1 < 64 && position[square+forwardOffset+1].side == opponent) {
+            if (square % 8 < 7 && square+forwardOffset+1 < 64 && position[square+forwardOffset+1].side == opponent) {
                 if (squareBeforeLastTwoRanks) {
-                    addMoveIfAcceptable(moves, {square, square+forwardOffset+1, 1}, opponent);
+                    addMoveIfAcceptable<us>(moves, {square, square+forwardOffset+1, 1});
                 } else {
                     // promo captures - right
-                    addAllPromotionsIfAcceptable(moves, {square, square+forwardOffset+1, 1}, opponent);
+                    addAllPromotionsIfAcceptable<us>(moves, {square, square+forwardOffset+1, 1});
                 }
             }
             // left
-            if (c.x > 0 && square + forwardOffset-1 >= 0 && position[square+forwardOffset-1].side == opponent) {
+            if (square % 8 > 0 && square + forwardOffset-1 >= 0 && position[square+forwardOffset-1].side == opponent) {
                 if (squareBeforeLastTwoRanks) {
-                    addMoveIfAcceptable(moves, {square, square+forwardOffset-1, 1}, opponent);
+                    addMoveIfAcceptable<us>(moves, {square, square+forwardOffset-1, 1});
                 } else {
                     // promo captures - left
-                    addAllPromotionsIfAcceptable(moves, {square, square+forwardOffset-1, 1}, opponent);
+                    addAllPromotionsIfAcceptable<us>(moves, {square, square+forwardOffset-1, 1});
                 }
             }
 
             // en passant capture
             if (enPassantPossible && square/8 == enPassantRank) {
                 if (lastDoublePawnPush == square+1)
-                    addMoveIfAcceptable(moves, {square, square+forwardOffset+1, 0, 1, 0, 1}, opponent, false, false, true);
+                    addMoveIfAcceptable<us>(moves, {square, square+forwardOffset+1, 0, 1, 0, 1}, false, false, true);
 
                 else if (lastDoublePawnPush == square-1)
-                    addMoveIfAcceptable(moves, {square, square+forwardOffset-1, 0, 1, 0, 1}, opponent, false, false, true);
+                    addMoveIfAcceptable<us>(moves, {square, square+forwardOffset-1, 0, 1, 0, 1}, false, false, true);
             }
 
         } break;
     }
 }
 
-void Board::generateAllMoves(std::vector<Move>& moves) const {
-    for (int square = 0; square < 64; square++) {
-        if (position[square].side == sideToPlay) {
-            std::vector<Move> movesAtSquare;
-            generateMoves(square, movesAtSquare);
-
-            // insert movesAtSquare at the end of moves
-            moves.reserve(moves.size() + distance(movesAtSquare.begin(),movesAtSquare.end()));
-            moves.insert(moves.end(),movesAtSquare.begin(),movesAtSquare.end());
-        }
-    }
-}
-
+template <Side us>
 void Board::addMoveIfAcceptable(
     std::vector<Move>& moves,
     Move move,
-    const Side& opponent,
     const bool isKing,
     const bool isKnight,
     const bool enPassant
     ) const {
 
+    constexpr Side opponent = opponentOf(us);
     const Piece& piece = position[move.before];
 
-    std::array<Piece, 64> hypotheticalPos;
-    makeHypotheticalMoveInPosition(position, hypotheticalPos, move.before, move.after, piece, enPassant, move.special1);
-    bool opponentInCheck;
-
-    if (isKing) {
-        
-        std::unordered_map<Side, int> kingPositions = kingsData.positions;
-        kingPositions[piece.side] = move.after;
-
-        std::unordered_map<Side, std::vector<int>*> knightAttacksAroundKings = kingsData.knightAttacks;
-        knightAttacksAroundKings.at(piece.side) = &knightAttacksAtSquare[move.after];
-
-        if (sideInCheck(piece.side,hypotheticalPos,kingPositions,knightAttacksAroundKings))
-            return; // can't put yourself in check
+    // Out of check, the king doesn't block any of the opponent's lines, so the squares it may go to
+    // are just the ones the opponent doesn't attack. Castling is only generated out of check.
+    if (isKing && !check.at(us)) {
+        if (attacked(opponent, move.after)) return;    // can't put yourself in check
 
         if (move.special1) {
-            int duringCastleSquare;
-            if (!move.special0) duringCastleSquare = move.after-1;  // king-side castle
-            else duringCastleSquare = move.after+1;                 // queen-side castle
-            
-            std::array<Piece, 64> duringCastle;
-            makeHypotheticalMoveInPosition(position, duringCastle, move.before, duringCastleSquare, piece);
-
-            std::unordered_map<Side, int> kingPositions = kingsData.positions;
-            kingPositions[piece.side] = duringCastleSquare;
-
-            std::unordered_map<Side, std::vector<int>*> knightAttacksAroundKings = kingsData.knightAttacks;
-            knightAttacksAroundKings.at(piece.side) = &knightAttacksAtSquare[duringCastleSquare];
-
-            if (sideInCheck(piece.side, duringCastle, kingPositions, knightAttacksAroundKings)) return;
+            const int duringCastleSquare = move.special0 ? move.after+1 : move.after-1;    // queen-side : king-side
+            if (attacked(opponent, duringCastleSquare)) return;
         }
+    }
 
-        opponentInCheck = sideInCheck(opponent,hypotheticalPos,kingPositions,knightAttacksAroundKings);
+    // A piece off the lines through its king can't uncover an attack on it, so then only a check
+    // that is already there needs looking at (en passant also removes a second piece). Otherwise
+    // the move can't be illegal and whether it checks is worked out without making it.
+    const bool castle = isKing && move.special1;
+    const bool needsPosition = isKing ? (check.at(us) || castle) : (check.at(us) || enPassant || mayBePinned(move.before));
 
-    } else {
-        if (sideInCheck(piece.side,hypotheticalPos,kingsData.positions,kingsData.knightAttacks))
+    if (needsPosition) {
+        std::array<Piece, 64> hypotheticalPos;
+        makeHypotheticalMoveInPosition(position, hypotheticalPos, move.before, move.after, piece, enPassant, castle);
+
+        if (sideInCheckAt<us>(hypotheticalPos, isKing ? move.after : kingsData.positions.at(us)))
             return; // can't put yourself in check
 
-        opponentInCheck = sideInCheck(opponent,hypotheticalPos,kingsData.positions,kingsData.knightAttacks);
+        move.willBeCheck = sideInCheckAt<opponent>(hypotheticalPos, kingsData.positions.at(opponent));
+    } else {
+        move.willBeCheck = givesCheck<us>(move.before, move.after);
     }
 
-    if (opponentInCheck)
-        move.willBeCheck = true;
-    
     moves.push_back(move);
     
 }
 
+template <Side us>
 void Board::addAllPromotionsIfAcceptable(
     std::vector<Move>& moves,
-    const Move move, // in the form {before, after, capture} (not by reference because rvalues need to be possible)
-    const Side& opponent
+    const Move move // in the form {before, after, capture} (not by reference because rvalues need to be possible)
     ) const {
     //Log(LogLevel::DEBUG, "addAllPromotionsIfAcceptable");
 
-    const Side& side = position[move.before].side;
+    constexpr Side opponent = opponentOf(us);
+    const int king = kingsData.positions.at(us);
+    const int opponentKing = kingsData.positions.at(opponent);
 
     std::array<Piece, 64> queenPromo;
-    makeHypotheticalMoveInPosition(position, queenPromo, move.before, move.after, {PieceType::QUEEN, side});
+    makeHypotheticalMoveInPosition(position, queenPromo, move.before, move.after, {PieceType::QUEEN, us});
 
     // check if we're not putting ourselves in check
-    if (sideInCheck(side, queenPromo, kingsData.positions, kingsData.knightAttacks)) return;
+    if (sideInCheckAt<us>(queenPromo, king)) return;
 
 
     std::array<Piece, 64> rookPromo;
     std::array<Piece, 64> bishopPromo;
     std::array<Piece, 64> knightPromo;
 
-    makeHypotheticalMoveInPosition(position, rookPromo, move.before, move.after, {PieceType::ROOK, side});
-    makeHypotheticalMoveInPosition(position, bishopPromo, move.before, move.after, {PieceType::BISHOP, side});
-    makeHypotheticalMoveInPosition(position, knightPromo, move.before, move.after, {PieceType::KNIGHT, side});
+    makeHypotheticalMoveInPosition(position, rookPromo, move.before, move.after, {PieceType::ROOK, us});
+    makeHypotheticalMoveInPosition(position, bishopPromo, move.before, move.after, {PieceType::BISHOP, us});
+    makeHypotheticalMoveInPosition(position, knightPromo, move.before, move.after, {PieceType::KNIGHT, us});
 
     moves.emplace_back(move.before, move.after, 1, move.capture, 1, 1,
-        sideInCheck(opponent, queenPromo, kingsData.positions, kingsData.knightAttacks));   // queen promo
+        sideInCheckAt<opponent>(queenPromo, opponentKing));   // queen promo
 
     moves.emplace_back(move.before, move.after, 1, move.capture, 0, 0,
-        sideInCheck(opponent, knightPromo, kingsData.positions, kingsData.knightAttacks));  // knight promo
+        sideInCheckAt<opponent>(knightPromo, opponentKing));  // knight promo
 
     moves.emplace_back(move.before, move.after, 1, move.capture, 1, 0,
-        sideInCheck(opponent, rookPromo, kingsData.positions, kingsData.knightAttacks));    // rook promo
+        sideInCheckAt<opponent>(rookPromo, opponentKing));    // rook promo
 
     moves.emplace_back(move.before, move.after, 1, move.capture, 0, 1,
-        sideInCheck(opponent, bishopPromo, kingsData.positions, kingsData.knightAttacks));  // bishop promo
+        sideInCheckAt<opponent>(bishopPromo, opponentKing));  // bishop promo
 
     // (see https://www.chessprogramming.org/Encoding_Moves)
 }
@@ -486,185 +698,139 @@ void Board::makeHypotheticalMoveInPosition(
 }
 
 
+template <Side us>
 void Board::generateMovesInDirection(
-        const Coordinate& coord,
-        const int& square,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        std::vector<Move>& moves,
-        const Side& opponent
+        const int square,
+        const int direction,
+        std::vector<Move>& moves
     ) const {
     //Log(LogLevel::DEBUG, "generateMovesInDirection");
-    int nextSquare;
-    Coordinate nextCoord;
-    Coordinate lastCoord = coord;
-
-    for (int i = 1; i < 8; i++) {
-        nextCoord = directionFunc(lastCoord);
-
-        if (WITHIN_BOUNDS(nextCoord)) {
-            nextSquare = COORD_TO_SQUARE(nextCoord);
-            if (position[nextSquare].side == Side::EMPTY) {
-                addMoveIfAcceptable(moves, {square, nextSquare}, opponent);
-                lastCoord = nextCoord;
-            } else if (position[nextSquare].side == opponent) { // capture
-                addMoveIfAcceptable(moves, {square, nextSquare, true}, opponent);
-                break;
-            } else break;
-
-        } else break;
+    for (const int nextSquare : attacks::rays[direction][square]) {
+        if (position[nextSquare].side == Side::EMPTY) {
+            addMoveIfAcceptable<us>(moves, {square, nextSquare});
+        } else {
+            if (position[nextSquare].side == opponentOf(us)) // capture
+                addMoveIfAcceptable<us>(moves, {square, nextSquare, true});
+            break;
+        }
     }
 }
 
-constexpr PieceType Board::getNextOpponentPieceInDirection(
-        const Coordinate& coord,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        const Side& opponent
-    ) const {
-    return getNextOpponentPieceInDirection(coord, position, directionFunc, opponent);
-}
+template <Side us>
+bool Board::givesCheck(const int before, const int after) const {
+    const int king = kingsData.positions.at(opponentOf(us));
+    const uint64_t occupiedAfter = (occupied & ~(1ULL << before)) | (1ULL << after);
 
-constexpr PieceType Board::getNextOpponentPieceInDirection(
-        const Coordinate& coord,
-        const std::array<Piece, 64>& position,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        const Side& opponent
-    ) const {
-    //Log(LogLevel::DEBUG, "getNextOpponentPieceInDirection");
-    Coordinate nextCoord = coord;
+    const auto slidesAlong = [](const PieceType type, const int direction) {
+        return type == PieceType::QUEEN || type == (attacks::isDiagonal(direction) ? PieceType::BISHOP : PieceType::ROOK);
+    };
 
-    for (int i = 1; i < 8; i++) {
-        nextCoord = directionFunc(nextCoord);
+    // from the square it goes to
+    const PieceType type = position[before].type;
+    if (type == PieceType::PAWN) {
+        for (const int square : attacks::pawnAttacks[(int)us][after]) if (square == king) return true;
+    } else if (type == PieceType::KNIGHT) {
+        for (const int square : attacks::knightMoves[after]) if (square == king) return true;
+    } else {
+        const int direction = attacks::directionTo[after][king];
+        if (direction != attacks::NONE && slidesAlong(type, direction)
+            && (attacks::between[after][king] & occupiedAfter) == 0) return true;
+    }
+
+    // from one of ours behind the square it leaves
+    const int direction = attacks::directionTo[king][before];
+    if (direction == attacks::NONE) return false;
+    const uint64_t line = attacks::rayMasks[direction][king] & occupiedAfter;
+    if (line == 0) return false;
 
-        if (WITHIN_BOUNDS(nextCoord)) {
-            const unsigned short nextSquare = COORD_TO_SQUARE(nextCoord);
-            const PieceType nextType = position[nextSquare].type;
+    const int first = attacks::nearest(direction, line);
+    return first != after && position[first].side == us && slidesAlong(position[first].type, direction);
+}
 
-            if (position[nextSquare].side == opponent) { // capture
-                return nextType;
-            } else if (nextType != PieceType::EMPTY) break;
+bool Board::emptyBetween(const int from, const int to) const {
+    if (to < 0 || to >= 64 || attacks::directionTo[from][to] == attacks::NONE) return false;
 
-        } else break;
+    uint64_t squares = attacks::between[from][to];
+    while (squares) {
+        if (position[attacks::popSquare(squares)].type != PieceType::EMPTY) return false;
     }
+    return true;
+}
+
+bool Board::mayBePinned(const int square) const {
+    const Side side = position[square].side;
+    const int king = kingsData.positions.at(side);
 
-    return PieceType::EMPTY;
+    const int direction = attacks::directionTo[king][square];
+    if (direction == attacks::NONE || !emptyBetween(king, square)) return false;
 
+    // the first piece behind it, looking away from the king
+    for (const int behind : attacks::rays[direction][square]) {
+        const Piece& piece = position[behind];
+        if (piece.type == PieceType::EMPTY) continue;
+        if (piece.side == side) return false;
+
+        return piece.type == PieceType::QUEEN
+            || piece.type == (attacks::isDiagonal(direction) ? PieceType::BISHOP : PieceType::ROOK);
+    }
+    return false;
 }
 
 bool Board::sideInCheck(const Side& side) const {
-    return sideInCheck(side, position, kingsData.positions, kingsData.knightAttacks);
+    return attacked(opponentOf(side), kingsData.positions.at(side));
 }
 
 bool Board::sideInCheck(
     const Side& side,
     const std::array<Piece, 64>& position,
-    const std::unordered_map<Side, int>& kingPositions,
-    const std::unordered_map<Side, std::vector<int>*>& knightAttacksAroundKings
+    const BySide<int>& kingPositions
     ) const {
+    const int king = kingPositions.at(side);
+    if (side == Side::WHITE) return sideInCheckAt<Side::WHITE>(position, king);
+    return sideInCheckAt<Side::BLACK>(position, king);
+}
+
+template <Side side>
+bool Board::sideInCheckAt(const std::array<Piece, 64>& position, const int king) const {
     //Log(LogLevel::INFO, "Checking for check!"); // Leaving this here to optimise when we're looking for checks later
 
-    const Coordinate king_pos = SQUARE_TO_COORD(kingPositions.at(side));
-    const Side opponent = (side == Side::WHITE) ? Side::BLACK : Side::WHITE;
+    constexpr Side opponent = opponentOf(side);
 
-    // Checking only for opponent is built in to this lambda!
-    const auto checkForPieceAtCoord = [&](const Coordinate coord, const PieceType type) {
-        if (WITHIN_BOUNDS(coord)) {
-            const Piece& piece_at_coord = position[COORD_TO_SQUARE(coord)];
-            if (piece_at_coord.side == opponent && piece_at_coord.type == type)
-                return true;
-        }
-        return false;
+    const auto opponentPieceAt = [&](const int square, const PieceType type) {
+        return position[square].side == opponent && position[square].type == type;
     };
 
-    // Look for knights
-    for (const int& candidate : *knightAttacksAroundKings.at(side)) {
-        const Piece& pieceAtSquare = position[candidate];
-        if (pieceAtSquare.side == opponent && pieceAtSquare.type == PieceType::KNIGHT) {
-            return true;
-        }
+    // Kings can't stand next to each other
+    for (const int square : attacks::kingMoves[king]) {
+        if (opponentPieceAt(square, PieceType::KING)) return true;
     }
-    //Log(LogLevel::DEBUG, "No knight checks found");
-
-    // Look for enemy pawns in front
 
-    if (side == Side::WHITE) {
-        if (checkForPieceAtCoord(dirs::northeast(king_pos), PieceType::PAWN)) return true;
-        if (checkForPieceAtCoord(dirs::northwest(king_pos), PieceType::PAWN)) return true;
-
-    } else {
-        if (checkForPieceAtCoord(dirs::southeast(king_pos), PieceType::PAWN)) return true;
-        if (checkForPieceAtCoord(dirs::southwest(king_pos), PieceType::PAWN)) return true;
+    // Look for knights
+    for (const int square : attacks::knightMoves[king]) {
+        if (opponentPieceAt(square, PieceType::KNIGHT)) return true;
     }
 
-    //Log(LogLevel::DEBUG, "No pawn checks found");
+    // Look for enemy pawns in front (the squares our pawn would attack from the king's square)
+    for (const int square : attacks::pawnAttacks[(int)side][king]) {
+        if (opponentPieceAt(square, PieceType::PAWN)) return true;
+    }
 
     // Look for sliding pieces
-    {   // namespace for all these variables
-        const PieceType check_n = getNextOpponentPieceInDirection(king_pos, position, dirs::north, opponent);
-        if (check_n == PieceType::QUEEN || check_n == PieceType::ROOK) return true;
-
-        const PieceType check_s = getNextOpponentPieceInDirection(king_pos, position, dirs::south, opponent);
-        if (check_s == PieceType::QUEEN || check_s == PieceType::ROOK) return true;
-
-        const PieceType check_e = getNextOpponentPieceInDirection(king_pos, position, dirs::east, opponent);
-        if (check_e == PieceType::QUEEN || check_e == PieceType::ROOK) return true;
-
-        const PieceType check_w = getNextOpponentPieceInDirection(king_pos, position, dirs::west, opponent);
-        if (check_w == PieceType::QUEEN || check_w == PieceType::ROOK) return true;
-
-        //Log(LogLevel::DEBUG, "No lateral checks found");
+    for (int direction = 0; direction < 8; direction++) {
+        const PieceType slider = attacks::isDiagonal(direction) ? PieceType::BISHOP : PieceType::ROOK;
 
-        const PieceType check_ne = getNextOpponentPieceInDirection(king_pos, position, dirs::northeast, opponent);
-        if (check_ne == PieceType::QUEEN || check_ne == PieceType::BISHOP) return true;
+        for (const int square : attacks::rays[direction][king]) {
+            const Piece& piece = position[square];
+            if (piece.type == PieceType::EMPTY) continue;
 
-        const PieceType check_nw = getNextOpponentPieceInDirection(king_pos, position, dirs::northwest, opponent);
-        if (check_nw == PieceType::QUEEN || check_nw == PieceType::BISHOP) return true;
-
-        const PieceType check_se = getNextOpponentPieceInDirection(king_pos, position, dirs::southeast, opponent);
-        if (check_se == PieceType::QUEEN || check_se == PieceType::BISHOP) return true;
-
-        const PieceType check_sw = getNextOpponentPieceInDirection(king_pos, position, dirs::southwest, opponent);
-        if (check_sw == PieceType::QUEEN || check_sw == PieceType::BISHOP) return true;
-
-        //Log(LogLevel::DEBUG, "No diagonal checks found");
+            if (piece.side == opponent && (piece.type == PieceType::QUEEN || piece.type == slider)) return true;
+            break;
+        }
     }
 
     return false;
 }
 
-void Board::fillKnightAttacksArray() {
-    for (int square = 0; square < 64; square++) {
-        const Coordinate coord = SQUARE_TO_COORD(square);
-
-        const std::array<Coordinate, 8> possible = {
-                dirs::north(dirs::north(dirs::east(coord))),
-                dirs::north(dirs::north(dirs::west(coord))),
-                dirs::north(dirs::east (dirs::east(coord))),
-                dirs::north(dirs::west (dirs::west(coord))),
-                dirs::south(dirs::south(dirs::east(coord))),
-                dirs::south(dirs::south(dirs::west(coord))),
-                dirs::south(dirs::east (dirs::east(coord))),
-                dirs::south(dirs::west (dirs::west(coord)))
-        };
-
-        for (const auto& possibleCoord : possible) {
-            if (WITHIN_BOUNDS(possibleCoord))
-                knightAttacksAtSquare[square].push_back(COORD_TO_SQUARE(possibleCoord));
-        }
-    }
-}
-
-void Board::fillKingMovesArray() {
-    for (int square = 0; square < 64; square++) {
-        const Coordinate c = SQUARE_TO_COORD(square);
-
-        const std::array<Coordinate, 8> possible = {
-                dirs::north(c),     dirs::south(c),     dirs::east(c),      dirs::west(c),
-                dirs::northeast(c), dirs::southeast(c), dirs::northwest(c), dirs::southwest(c)
-        };
-
-        for (const auto& possibleCoord : possible) {
-            if (WITHIN_BOUNDS(possibleCoord))
-                kingMovesAtSquare[square].push_back(COORD_TO_SQUARE(possibleCoord));
-        }
-    }
-}
\ No newline at end of file
+// the benchmark (microbench.cpp) calls this one from outside the file
+template void Board::addMoveIfAcceptable<Side::WHITE>(std::vector<Move>&, Move, const bool, const bool, const bool) const;
+template void Board::addMoveIfAcceptable<Side::BLACK>(std::vector<Move>&, Move, const bool, const bool, const bool) const;
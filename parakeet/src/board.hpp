@@ -3,48 +3,77 @@
 #include <array>
 #include <vector>
 #include <string>
-#include <unordered_map>
-#include <functional>
+#include <cstdint>
 
 #include "move.hpp"
 #include "types/piece.hpp"
 #include "types/side.hpp"
-#include "types/coordinate.hpp"
 #include "types/piecetype.hpp"
+#include "types/piecevalues.hpp"
+#include "types/packedposition.hpp"
+#include "types/material.hpp"
+
+// Which squares each side attacks. A piece attacks the squares it could capture on, whether they are
+// empty or hold a piece of either side.
+struct AttackMaps {
+    std::array<std::array<uint8_t, 64>, 2> counts{};    // [side][square]: how many of the side's pieces attack it
+
+    // a bit for every square the side attacks
+    uint64_t squares(const Side side) const;
+};
 
 class Board {
+    friend class MicroBench;    // times the private move generation helpers (microbench.cpp)
+
 public:
     std::array<Piece, 64> position;
     Side sideToPlay;
     
-    std::unordered_map<Side, bool> castlingRightsKingSide;
-    std::unordered_map<Side, bool> castlingRightsQueenSide;
+    BySide<bool> castlingRightsKingSide;
+    BySide<bool> castlingRightsQueenSide;
 
-    std::unordered_map<Side, bool> check;
+    BySide<bool> check;
     
     bool enPassantPossible;
     unsigned short lastDoublePawnPush; // 64 when there was no last double pawn push
 
     int materialDifference;
+    uint64_t materialKey;   // piece counts (types/material.hpp), kept up to date in makeMove
+
+    int halfmoveClock;  // plies since the last capture or pawn move
+    int fullmoveNumber; // starts at 1 and goes up after each of black's moves
+
+    uint64_t hash; // zobrist key, kept up to date in makeMove
+
+    AttackMaps attackMaps;  // kept up to date in makeMove
 
 private:
 
-    static std::unordered_map<PieceType, int>* pieceValues_ptr;
-    static std::array<std::vector<int>, 64> knightAttacksAtSquare;
-    static std::array<std::vector<int>, 64> kingMovesAtSquare;
+    // Used for materialDifference. Owned by whoever configured the board (usually an Engine).
+    const PieceValues* pieceValues = &DEFAULT_PIECE_VALUES;
 
     struct {
-        std::unordered_map<Side, int> positions;
-        std::unordered_map<Side, std::vector<int>*> knightAttacks;
+        BySide<int> positions;
     } kingsData;
 
+    uint64_t occupied = 0;  // a bit for every square with a piece on it, for the attack map updates
+
 public:
     Board();
-    Board(std::array<Piece, 64>& position, Side sideToPlay,
-    bool whiteCanCastleKingSide, bool whiteCanCastleQueenSide, bool blackCanCastleKingSide, bool blackCanCastleQueenSide,
-    bool enPassantPossible, unsigned short lastDoublePawnPush, int materialDifference=0);
 
-    void setPieceValues(std::unordered_map<PieceType, int>& pieceValues);
+    // Replaces the position in place and works out what follows from it (kings, check, material, hash)
+    void setUp(const std::array<Piece, 64>& position, const Side sideToPlay,
+        bool whiteCanCastleKingSide, bool whiteCanCastleQueenSide, bool blackCanCastleKingSide, bool blackCanCastleQueenSide,
+        bool enPassantPossible, unsigned short lastDoublePawnPush, int halfmoveClock=0, int fullmoveNumber=1);
+
+    // The position in 32 bytes. result and score are left unknown for the caller to fill in.
+    PackedPosition pack() const;
+    // Sets up a packed position. Returns false, leaving the board alone, if it isn't a valid one.
+    bool unpack(const PackedPosition& packed);
+
+    // values must outlive the board and any copies of it
+    void setPieceValues(const PieceValues& values);
+    const PieceValues& getPieceValues() const { return *pieceValues; }
 
     void makeMove(const Move& move);
 
@@ -55,39 +84,64 @@ public:
 
     std::string getPositionString() const;
 
+    uint64_t computeHash() const;
+    // from white's point of view, kings left out
+    int computeMaterialDifference() const;
+    uint64_t computeMaterialKey() const;
+    AttackMaps computeAttackMaps() const;
+    bool attacked(const Side by, const int square) const { return attackMaps.counts[(int)by][square] != 0; }
+    int kingSquare(const Side side) const { return kingsData.positions.at(side); }
+    uint64_t occupancy() const { return occupied; }
+    // en passant only counts (e.g. for hashing) if a pawn of the side to play can actually take
+    bool enPassantCapturePossible() const;
+
     bool sideInCheck(const Side& side) const;
     bool sideInCheck(
         const Side& side,
         const std::array<Piece, 64>& position,
-        const std::unordered_map<Side, int>& kingPositions,
-        const std::unordered_map<Side, std::vector<int>*>& knightAttacksAroundKings
+        const BySide<int>& kingPositions
     ) const;
 
-    static void fillKnightAttacksArray();
-    static void fillKingMovesArray();
-
 private:
+    uint64_t castlingAndEnPassantKey() const;
+
+    // Calls f with every square the piece on square attacks
+    template <typename F> void forEachAttack(const int square, F&& f) const;
+    // Adds (sign 1) or takes away (sign -1) the attacks of the piece on square
+    void updatePieceAttacks(const int square, const int sign);
+    // After square has been emptied (sign 1) or filled (sign -1), the sliders whose lines run
+    // through it reach further or less far
+    void updateLinesThrough(const int square, const int sign);
+    // Moves the piece on from to to (as piece, which differs for promotions), taking whatever is
+    // there, and keeps the attack maps up to date. The hash and material are left to the caller.
+    void movePiece(const int from, const int to, const Piece& piece);
+    void removePiece(const int square);
+
+    // The generator, makeMove and the check test are instantiated once for each side, so pawn
+    // directions, ranks, castling squares and the opponent are constants in them. The public
+    // functions above choose the instantiation from the side to play, once per call.
+    template <Side us> void makeMoveFor(const Move& move);
+    template <Side us> void generateMovesFor(const int square, std::vector<Move>& moves) const;
+    template <Side us> void generateAllMovesFor(std::vector<Move>& moves) const;
+
+    // whether side's king, standing on king, is attacked in position
+    template <Side side> bool sideInCheckAt(const std::array<Piece, 64>& position, const int king) const;
+
+    template <Side us>
     void generateMovesInDirection(
-        const Coordinate& coord,
-        const int& square,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        std::vector<Move>& moves,
-        const Side& opponent
+        const int square,
+        const int direction,    // attacks::Direction
+        std::vector<Move>& moves
     ) const;
 
-    constexpr PieceType getNextOpponentPieceInDirection(
-        const Coordinate& coord,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        const Side& opponent
-    ) const;
-
-    constexpr PieceType getNextOpponentPieceInDirection(
-        const Coordinate& coord,
-        const std::array<Piece, 64>& position,
-        const std::function<Coordinate(Coordinate)>& directionFunc,
-        const Side& opponent
-    ) const;
+    // Whether moving the piece on before to after checks the opponent, directly or by uncovering a
+    // line. Not for castling, en passant or promotions, which change a second square or the piece.
+    template <Side us> bool givesCheck(const int before, const int after) const;
 
+    // true if there are only empty squares between the two, which have to be on a line
+    bool emptyBetween(const int from, const int to) const;
+    // false if moving the piece on the square certainly can't expose its own king
+    bool mayBePinned(const int square) const;
 
     void makeHypotheticalMoveInPosition(
         const std::array<Piece, 64>& oldPosition,
@@ -100,7 +154,7 @@ private:
     ) const;
 
     void getChecksIfMove(
-        std::unordered_map<Side, bool>& checks,
+        BySide<bool>& checks,
         const int before,
         const int after,
         const Piece& piece,
@@ -110,19 +164,19 @@ private:
         ) const;
 
     // Adds move to moves if it doesn't place the moving side in check. Also adjusts willBeCheck in move.
+    template <Side us>
     void addMoveIfAcceptable(
         std::vector<Move>& moves,
         Move move,
-        const Side& opponent,
         const bool isKing = false,
         const bool isKnight = false,
         const bool enPassant = false
     ) const;
 
     // Adds all promotions if pawn move acceptable
+    template <Side us>
     void addAllPromotionsIfAcceptable(
         std::vector<Move>& moves,
-        Move move, // in the form {before, after, capture}
-        const Side& opponent
+        Move move // in the form {before, after, capture}
     ) const;
-};
\ No newline at end of file
+};
@@ -0,0 +1,113 @@
+#include "book.hpp"
+#include "log.hpp"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+std::shared_ptr<const OpeningBook> OpeningBook::open(const std::string& path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const OpeningBook>> books;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (std::shared_ptr<const OpeningBook> book = books[path].lock()) return book;
+
+    auto book = std::make_shared<const OpeningBook>(path);
+    if (!book->isOpen()) return nullptr;
+
+    books[path] = book;
+    return book;
+}
+
+OpeningBook::OpeningBook(const std::string& path) : m_file(path) {
+    if (m_file.isOpen() && m_file.size() % ENTRY_SIZE != 0)
+        Log(LogLevel::WARN, "Book size isn't a multiple of 16 bytes, ignoring the rest");
+}
+
+OpeningBook::Entry OpeningBook::entryAt(const size_t index) const {
+    const unsigned char* bytes = m_file.data() + index * ENTRY_SIZE;
+
+    const auto readBigEndian = [](const unsigned char* p, const int length) {
+        uint64_t out = 0;
+        for (int i = 0; i < length; i++) out = (out << 8) | p[i];
+        return out;
+    };
+
+    return {
+        readBigEndian(bytes, 8),
+        (uint16_t) readBigEndian(bytes + 8, 2),
+        (uint16_t) readBigEndian(bytes + 10, 2)
+    };
+}
+
+bool OpeningBook::probe(const Board& board, Move& out, const bool best, std::mt19937& rng) const {
+    if (!isOpen()) return false;
+
+    // binary search for the first entry with our key
+    size_t low = 0, high = entries();
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (entryAt(middle).key < board.hash) low = middle + 1;
+        else high = middle;
+    }
+
+    std::vector<Entry> candidates;
+    for (size_t i = low; i < entries(); i++) {
+        const Entry entry = entryAt(i);
+        if (entry.key != board.hash) break;
+        candidates.push_back(entry);
+    }
+    if (candidates.empty()) return false;
+
+    uint32_t totalWeight = 0;
+    for (const Entry& entry : candidates) totalWeight += entry.weight;
+
+    const Entry* chosen = &candidates[0];
+    if (best || totalWeight == 0) {
+        for (const Entry& entry : candidates) {
+            if (entry.weight > chosen->weight) chosen = &entry;
+        }
+    } else {
+        uint32_t pick = std::uniform_int_distribution<uint32_t>(0, totalWeight - 1)(rng);
+        for (const Entry& entry : candidates) {
+            if (pick < entry.weight) {
+                chosen = &entry;
+                break;
+            }
+            pick -= entry.weight;
+        }
+    }
+
+    return toMove(board, chosen->move, out);
+}
+
+bool OpeningBook::toMove(const Board& board, const uint16_t bookMove, Move& out) const {
+    // bits: to file (0-2), to row (3-5), from file (6-8), from row (9-11), promotion piece (12-14)
+    const int after = bookMove & 63;
+    const int before = (bookMove >> 6) & 63;
+    const int promotion = (bookMove >> 12) & 7;    // 0 none, 1 knight, 2 bishop, 3 rook, 4 queen
+
+    std::vector<Move> moves;
+    board.generateMoves(before, moves);
+
+    for (const Move& move : moves) {
+        int target = move.after;
+        // castling is stored as the king taking its own rook
+        if (move.isKingSideCastle()) target = move.after + 1;
+        else if (move.isQueenSideCastle()) target = move.after - 2;
+
+        if (target != after) continue;
+
+        if (move.promotion) {
+            const int piece = (move.special1 ? 2 : 0) + (move.special0 ? 1 : 0);    // N, B, R, Q
+            if (promotion != piece + 1) continue;
+        } else if (promotion != 0) continue;
+
+        out = move;
+        return true;
+    }
+
+    Log(LogLevel::WARN, "Book move isn't legal in this position");
+    return false;
+}
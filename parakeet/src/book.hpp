@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <random>
+#include <cstdint>
+
+#include "board.hpp"
+#include "move.hpp"
+#include "mappedfile.hpp"
+
+/* Polyglot (.bin) opening book (see http://hgm.nubati.net/book_format.html).
+ * The file is a sorted array of 16 byte big-endian entries: key, move, weight, learn.
+ * Books are looked up with Board::hash, which uses the Polyglot key layout.
+ */
+class OpeningBook {
+public:
+    // Books are shared: opening the same path again returns the mapping that's already there
+    static std::shared_ptr<const OpeningBook> open(const std::string& path);
+
+    OpeningBook(const std::string& path);
+
+    bool isOpen() const { return m_file.isOpen(); }
+    size_t entries() const { return m_file.size() / ENTRY_SIZE; }
+
+    // Finds a book move for the position. If best is set, the move with the highest weight is
+    // chosen, otherwise one is picked at random in proportion to the weights.
+    bool probe(const Board& board, Move& out, const bool best, std::mt19937& rng) const;
+
+private:
+    static constexpr size_t ENTRY_SIZE = 16;
+
+    struct Entry {
+        uint64_t key;
+        uint16_t move;
+        uint16_t weight;
+    };
+
+    MappedFile m_file;
+
+    Entry entryAt(const size_t index) const;
+    bool toMove(const Board& board, const uint16_t bookMove, Move& out) const;
+};
@@ -0,0 +1,144 @@
+#include "parakeet.h"
+#include "engine.hpp"
+#include "utility.hpp"
+#include "log.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <exception>
+
+struct parakeet_engine {
+    Engine engine;
+};
+
+namespace {
+    const char* STARTING_POSITION = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    // exceptions mustn't cross into C
+    template<typename F>
+    int guarded(F function) {
+        try {
+            return function();
+        } catch (const std::exception& e) {
+            Log(LogLevel::ERROR, e.what());
+            return PARAKEET_ERROR_INTERNAL;
+        } catch (...) {
+            return PARAKEET_ERROR_INTERNAL;
+        }
+    }
+}
+
+extern "C" {
+
+parakeet_engine* parakeet_new(void) {
+    try {
+        return new parakeet_engine();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void parakeet_free(parakeet_engine* engine) {
+    delete engine;
+}
+
+int parakeet_new_game(parakeet_engine* engine) {
+    if (engine == nullptr) return PARAKEET_ERROR_ARGUMENT;
+    return guarded([&]() -> int {
+        engine->engine.newGame();
+        return PARAKEET_OK;
+    });
+}
+
+int parakeet_set_position(parakeet_engine* engine, const char* fen, const char* moves) {
+    if (engine == nullptr) return PARAKEET_ERROR_ARGUMENT;
+    return guarded([&]() -> int {
+        const std::string text = (fen == nullptr) ? STARTING_POSITION : fen;
+
+        // played on a copy, so a bad move leaves the engine where it was
+        Board board = engine->engine.board;
+        const char* error = nullptr;
+        if (!loadFEN(text, board, &error)) {
+            Log(LogLevel::WARN, std::string("Invalid FEN: ") + error);
+            return PARAKEET_ERROR_FEN;
+        }
+
+        std::istringstream stream(moves == nullptr ? "" : moves);
+        std::string word;
+        while (stream >> word) {
+            Move move;
+            if (!fromUCI(word, board, move)) {
+                Log(LogLevel::WARN, "Illegal move " + word);
+                return PARAKEET_ERROR_MOVE;
+            }
+            board.makeMove(move);
+        }
+
+        engine->engine.board = board;
+        return PARAKEET_OK;
+    });
+}
+
+int parakeet_search(parakeet_engine* engine, const parakeet_limits* limits, parakeet_result* result) {
+    if (engine == nullptr || result == nullptr) return PARAKEET_ERROR_ARGUMENT;
+    return guarded([&]() -> int {
+        SearchLimits searchLimits;
+        if (limits != nullptr) {
+            if (limits->depth < 0) return PARAKEET_ERROR_ARGUMENT;
+            searchLimits.depth = limits->depth;
+            searchLimits.nodes = limits->nodes;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const SearchResult searchResult = engine->engine.analyse(searchLimits);
+
+        std::memset(result, 0, sizeof(parakeet_result));
+        if (searchResult.bestMove.beforeAndAfterDifferent()) {
+            const std::string move = uci(searchResult.bestMove);
+            std::memcpy(result->best_move, move.c_str(), move.size());
+        }
+        result->score = searchResult.eval;
+        result->depth = searchResult.depth;
+        result->nodes = searchResult.nodes;
+        result->time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return PARAKEET_OK;
+    });
+}
+
+int parakeet_legal_moves(parakeet_engine* engine, char* buffer, size_t size) {
+    if (engine == nullptr || buffer == nullptr) return PARAKEET_ERROR_ARGUMENT;
+    return guarded([&]() -> int {
+        std::vector<Move> moves;
+        engine->engine.board.generateAllMoves(moves);
+
+        std::string out;
+        for (const Move& move : moves) {
+            if (!out.empty()) out += ' ';
+            out += uci(move);
+        }
+
+        if (out.size() + 1 > size) return PARAKEET_ERROR_BUFFER;
+        std::memcpy(buffer, out.c_str(), out.size() + 1);
+        return (int) moves.size();
+    });
+}
+
+int parakeet_get_fen(parakeet_engine* engine, char* buffer, size_t size) {
+    if (engine == nullptr || buffer == nullptr) return PARAKEET_ERROR_ARGUMENT;
+    return guarded([&]() -> int {
+        const size_t length = writeFEN(engine->engine.board, buffer, size);
+        return (length == 0) ? PARAKEET_ERROR_BUFFER : (int) length;
+    });
+}
+
+int64_t parakeet_perft(parakeet_engine* engine, int depth) {
+    if (engine == nullptr || depth < 0) return PARAKEET_ERROR_ARGUMENT;
+    try {
+        return (int64_t) engine->engine.perft(depth);
+    } catch (...) {
+        return PARAKEET_ERROR_INTERNAL;
+    }
+}
+
+}
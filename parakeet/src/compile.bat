@@ -1 +1,7 @@
-g++ .\main.cpp .\board.cpp .\move.cpp .\engine.cpp .\utility.cpp .\timer.cpp .\types\movecounter.cpp -o ..\bin/parakeet
\ No newline at end of file
+g++ -c -DPARAKEET_SHARED "-DPARAKEET_BUILD_ID=\"%DATE% %TIME%\"" .\board.cpp .\move.cpp .\engine.cpp .\utility.cpp .\timer.cpp .\types\movecounter.cpp .\types\piecevalues.cpp .\zobrist.cpp .\transpositiontable.cpp .\mappedfile.cpp .\book.cpp .\attacks.cpp .\tablebase.cpp .\searchcache.cpp .\matesolver.cpp .\endgame.cpp .\positionfile.cpp .\log.cpp .\capi.cpp
+ar rcs ..\bin\libparakeet.a *.o
+g++ -shared *.o -o ..\bin\parakeet.dll
+del *.o
+g++ .\main.cpp .\batch.cpp .\dataset.cpp .\selfplay.cpp .\match.cpp .\server.cpp .\tune.cpp ..\bin\libparakeet.a -o ..\bin/parakeet
+g++ .\microbench.cpp ..\bin\libparakeet.a -o ..\bin/parakeet-bench
+g++ .\movegenfuzz.cpp ..\bin\libparakeet.a -o ..\bin/parakeet-fuzz
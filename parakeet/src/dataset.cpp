@@ -0,0 +1,132 @@
+#include "dataset.hpp"
+#include "board.hpp"
+#include "utility.hpp"
+#include "positionfile.hpp"
+#include "log.hpp"
+
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+namespace dataset {
+namespace {
+    // The operand of an EPD opcode (e.g. "ce 35;"), empty if the line doesn't have it
+    std::string operand(const std::string& line, const std::string& opcode) {
+        for (size_t at = line.find(opcode + " "); at != std::string::npos; at = line.find(opcode + " ", at + 1)) {
+            if (at > 0 && line[at - 1] != ' ' && line[at - 1] != ';') continue;
+
+            const size_t start = at + opcode.size() + 1;
+            const size_t end = line.find(';', start);
+            std::string out = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            out.erase(std::remove(out.begin(), out.end(), '"'), out.end());
+            out.erase(std::remove(out.begin(), out.end(), ' '), out.end());
+            return out;
+        }
+        return "";
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int pack(int argc, char* argv[]) {
+    if (argc < 2) {
+        Log(LogLevel::ERROR, "Usage: parakeet pack <in> <out> [compress]");
+        return 1;
+    }
+    const std::string inPath = argv[0];
+    const bool compress = argc >= 3 && std::string(argv[2]) == "compress";
+
+    std::ifstream file;
+    if (inPath != "-") {
+        file.open(inPath);
+        if (!file) {
+            Log(LogLevel::ERROR, "Couldn't open " + inPath);
+            return 1;
+        }
+    }
+    std::istream& input = (inPath == "-") ? std::cin : file;
+
+    PositionWriter writer(argv[1], compress);
+    if (!writer.isOpen()) return 1;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::string line;
+    size_t lineNumber = 0, skipped = 0;
+    Board board;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+
+        const char* error = nullptr;
+        if (!loadFEN(line, board, &error)) {
+            Log(LogLevel::WARN, "Line " + std::to_string(lineNumber) + ": " + error);
+            skipped++;
+            continue;
+        }
+
+        PackedPosition packed = board.pack();
+        try {
+            const std::string score = operand(line, "ce");
+            if (!score.empty()) packed.score = (int16_t) std::clamp(std::stoi(score), -32767, 32767);
+
+            // the clocks of an EPD record
+            const std::string halfmoveClock = operand(line, "hmvc");
+            if (!halfmoveClock.empty()) packed.halfmoveClock = (uint8_t) std::clamp(std::stoi(halfmoveClock), 0, 255);
+            const std::string fullmoveNumber = operand(line, "fmvn");
+            if (!fullmoveNumber.empty()) packed.fullmoveNumber = (uint16_t) std::clamp(std::stoi(fullmoveNumber), 1, 65535);
+        } catch (const std::exception&) {
+            Log(LogLevel::WARN, "Line " + std::to_string(lineNumber) + ": bad operand, ignored");
+        }
+
+        const std::string result = operand(line, "c9");
+        if (result == "1-0") packed.result = 1;
+        else if (result == "0-1") packed.result = -1;
+        else if (result == "1/2-1/2") packed.result = 0;
+
+        writer.write(packed);
+    }
+
+    const uint64_t written = writer.size();
+    if (!writer.close()) return 1;
+    std::cout << "$pack positions " << written << " skipped " << skipped
+              << " time " << (int) (secondsSince(start) * 1000) << std::endl;
+    return 0;
+}
+
+int unpack(int argc, char* argv[]) {
+    if (argc < 1) {
+        Log(LogLevel::ERROR, "Usage: parakeet unpack <in>");
+        return 1;
+    }
+    const std::unique_ptr<PositionReader> reader = PositionReader::open(argv[0]);
+    if (!reader) {
+        Log(LogLevel::ERROR, std::string("Couldn't read ") + argv[0] + " as a position file");
+        return 1;
+    }
+
+    Board board;
+    PackedPosition packed;
+    uint64_t number = 0;
+    std::string out;
+    while (reader->next(packed)) {
+        number++;
+        if (!board.unpack(packed)) {
+            Log(LogLevel::WARN, "Record " + std::to_string(number) + " isn't a valid position");
+            continue;
+        }
+
+        out = getFEN(board, true);
+        out += " hmvc " + std::to_string(board.halfmoveClock) + "; fmvn " + std::to_string(board.fullmoveNumber) + ";";
+        if (packed.score != PackedPosition::NO_SCORE) out += " ce " + std::to_string(packed.score) + ";";
+        if (packed.result != PackedPosition::NO_RESULT)
+            out += std::string(" c9 \"") + (packed.result > 0 ? "1-0" : packed.result < 0 ? "0-1" : "1/2-1/2") + "\";";
+        std::cout << out << '\n';
+    }
+    std::cout << std::flush;
+    return 0;
+}
+}
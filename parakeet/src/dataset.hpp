@@ -0,0 +1,16 @@
+#pragma once
+
+/* Converting between FEN/EPD text and position files (positionfile.hpp)
+ *
+ * parakeet pack <in> <out> [compress]
+ *     packs one FEN or EPD record per line of in (stdin if in is -). The EPD opcodes ce (score for
+ *     the side to play), c9 (game result: "1-0", "0-1" or "1/2-1/2"), hmvc and fmvn are kept.
+ * parakeet unpack <in>
+ *     prints every record of a position file as an EPD line, with hmvc and fmvn, and ce and c9
+ *     when they are known.
+ */
+namespace dataset {
+    // argv without the program name and the subcommand. Both return the exit code.
+    int pack(int argc, char* argv[]);
+    int unpack(int argc, char* argv[]);
+}
@@ -0,0 +1,184 @@
+#include "endgame.hpp"
+
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+
+namespace endgame {
+namespace {
+    constexpr uint64_t PAWNS = material::mask(PieceType::PAWN);
+    constexpr uint64_t QUEENS = material::mask(PieceType::QUEEN);
+    constexpr uint64_t ROOKS = material::mask(PieceType::ROOK);
+
+    // Evaluators get the eval from the strong side's point of view and return it the same way
+    using Evaluator = int (*)(const Board& board, const Side strong, const int eval);
+
+    struct Entry {
+        uint64_t key = 0;
+        Evaluator evaluator = nullptr;  // nullptr marks an empty slot
+        Side strong = Side::WHITE;
+    };
+
+    // Open addressing with a handful of entries in each table, so a miss is usually a single load
+    constexpr int TABLE_BITS = 8;
+    using Slots = std::array<Entry, 1 << TABLE_BITS>;
+
+    size_t slot(const uint64_t key) {
+        return (key * 0x9E3779B97F4A7C15ull) >> (64 - TABLE_BITS);
+    }
+
+    const Entry* find(const Slots& slots, const uint64_t key) {
+        for (size_t i = slot(key);; i = (i + 1) % slots.size()) {
+            if (slots[i].evaluator == nullptr) return nullptr;
+            if (slots[i].key == key) return &slots[i];
+        }
+    }
+
+    int distance(const int a, const int b) {
+        return std::max(std::abs(a%8 - b%8), std::abs(a/8 - b/8));
+    }
+
+    bool darkSquare(const int square) {
+        return (square/8 + square%8) % 2 == 0;     // a1 is dark
+    }
+
+    int findPiece(const Board& board, const Piece& piece) {
+        for (int square = 0; square < 64; square++) {
+            if (board.position[square].type == piece.type && board.position[square].side == piece.side) return square;
+        }
+        return -1;
+    }
+
+    // Bishop and knight: mate can only be forced in a corner of the bishop's colour, so the
+    // defending king is driven there, with the kings close together
+    int kbnk(const Board& board, const Side strong, const int eval) {
+        const int strongKing = findPiece(board, {PieceType::KING, strong});
+        const int weakKing = findPiece(board, {PieceType::KING, opponentOf(strong)});
+        const int bishop = findPiece(board, {PieceType::BISHOP, strong});
+
+        const auto manhattan = [](const int a, const int b) { return std::abs(a%8 - b%8) + std::abs(a/8 - b/8); };
+        const int corner = darkSquare(bishop)
+            ? std::min(manhattan(weakKing, 0), manhattan(weakKing, 63))
+            : std::min(manhattan(weakKing, 7), manhattan(weakKing, 56));
+
+        return eval + 10 * (14 - corner) + 10 * (7 - distance(strongKing, weakKing));
+    }
+
+    // Rook against pawn: a win unless the pawn is far advanced with its king next to it and the
+    // other king is too far away to help (after Stockfish's KRKP)
+    int krkp(const Board& board, const Side strong, const int) {
+        const Side weak = opponentOf(strong);
+        const int strongKing = findPiece(board, {PieceType::KING, strong});
+        const int weakKing = findPiece(board, {PieceType::KING, weak});
+        const int rook = findPiece(board, {PieceType::ROOK, strong});
+        const int pawn = findPiece(board, {PieceType::PAWN, weak});
+
+        // ranks away from the one the pawn promotes on
+        const auto toPromotion = [weak](const int square) { return (weak == Side::WHITE) ? 7 - square/8 : square/8; };
+        const int forward = (weak == Side::WHITE) ? 8 : -8;
+        const int queeningSquare = pawn%8 + ((weak == Side::WHITE) ? 56 : 0);
+        const bool weakToPlay = (board.sideToPlay == weak);
+        const int rookValue = board.getPieceValues()[PieceType::ROOK];
+
+        if (strongKing%8 == pawn%8 && toPromotion(strongKing) < toPromotion(pawn))
+            return rookValue - distance(strongKing, pawn);     // the king is in front of the pawn
+
+        if (distance(weakKing, pawn) >= 3 + weakToPlay && distance(weakKing, rook) >= 3)
+            return rookValue - distance(strongKing, pawn);     // the rook picks the pawn up
+
+        if (toPromotion(weakKing) <= 2 && distance(weakKing, pawn) == 1
+                && toPromotion(strongKing) >= 3 && distance(strongKing, pawn) > 2 + !weakToPlay)
+            return 80 - 8 * distance(strongKing, pawn);
+
+        return 200 - 8 * (distance(strongKing, pawn + forward) - distance(weakKing, pawn + forward)
+            - distance(pawn, queeningSquare));
+    }
+
+    // A bishop each and pawns: with the bishops on opposite colours the extra pawns are hard to use
+    int oppositeBishops(const Board& board, const Side, const int eval) {
+        const int white = findPiece(board, {PieceType::BISHOP, Side::WHITE});
+        const int black = findPiece(board, {PieceType::BISHOP, Side::BLACK});
+        if (darkSquare(white) != darkSquare(black)) return eval / 2;
+        return eval;
+    }
+
+    struct Table {
+        Slots exact;        // looked up by the whole key
+        Slots anyPawns;     // by the key without the pawns, for when the exact one has nothing
+
+        Table() {
+            addBothSides(exact, "KBNK", kbnk);
+            addBothSides(exact, "KRKP", krkp);
+            add(anyPawns, material::key("KBKB"), oppositeBishops, Side::WHITE);
+        }
+
+        static void add(Slots& slots, const uint64_t key, const Evaluator evaluator, const Side strong) {
+            size_t i = slot(key);
+            while (slots[i].evaluator != nullptr) i = (i + 1) % slots.size();
+            slots[i] = {key, evaluator, strong};
+        }
+
+        // the signature has the strong side first
+        static void addBothSides(Slots& slots, const char* signature, const Evaluator evaluator) {
+            add(slots, material::key(signature), evaluator, Side::WHITE);
+            add(slots, material::mirror(material::key(signature)), evaluator, Side::BLACK);
+        }
+    };
+    const Table TABLE;
+
+    // Without pawns, a single minor piece can't mate, and two knights can't force it either unless
+    // the other side has pawns that stop its king getting away
+    bool cannotWin(const uint64_t key, const Side side) {
+        if (material::count(key, side, PieceType::PAWN) || material::count(key, side, PieceType::ROOK)
+                || material::count(key, side, PieceType::QUEEN)) return false;
+
+        const int knights = material::count(key, side, PieceType::KNIGHT);
+        const int bishops = material::count(key, side, PieceType::BISHOP);
+        if (knights + bishops <= 1) return true;
+        return bishops == 0 && knights == 2 && material::count(key, opponentOf(side), PieceType::PAWN) == 0;
+    }
+}
+
+bool insufficientMaterial(const Board& board) {
+    const uint64_t key = board.materialKey;
+    if (key & (PAWNS | ROOKS | QUEENS)) return false;
+
+    const int knights = material::count(key, Side::WHITE, PieceType::KNIGHT) + material::count(key, Side::BLACK, PieceType::KNIGHT);
+    const int bishops = material::count(key, Side::WHITE, PieceType::BISHOP) + material::count(key, Side::BLACK, PieceType::BISHOP);
+    if (knights + bishops <= 1) return true;
+    if (knights > 0) return false;
+
+    // only bishops: mate needs them on both colours
+    bool light = false, dark = false;
+    for (int square = 0; square < 64; square++) {
+        if (board.position[square].type != PieceType::BISHOP) continue;
+        if (darkSquare(square)) dark = true;
+        else light = true;
+    }
+    return !(light && dark);
+}
+
+int evaluate(const Board& board, const int materialEval) {
+    int eval = materialEval;
+    const uint64_t key = board.materialKey;
+    if (key & QUEENS) return eval;  // nothing here applies with a queen on the board
+
+    // The exact signatures all leave at least one side without pawns, and so does cannotWin, which
+    // makes the common case of pawns on both sides a single probe
+    const bool bothHavePawns = material::count(key, Side::WHITE, PieceType::PAWN) && material::count(key, Side::BLACK, PieceType::PAWN);
+
+    const Side us = board.sideToPlay;
+    const Entry* entry = bothHavePawns ? nullptr : find(TABLE.exact, key);
+    if (entry == nullptr) entry = find(TABLE.anyPawns, key & ~PAWNS);
+    if (entry != nullptr) {
+        const int strongEval = entry->evaluator(board, entry->strong, (entry->strong == us) ? eval : -eval);
+        eval = (entry->strong == us) ? strongEval : -strongEval;
+    }
+    if (bothHavePawns) return eval;
+
+    if (eval > 0 && cannotWin(key, us)) return 0;
+    if (eval < 0 && cannotWin(key, opponentOf(us))) return 0;
+    return eval;
+}
+
+}
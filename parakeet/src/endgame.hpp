@@ -0,0 +1,19 @@
+#pragma once
+
+#include "board.hpp"
+
+/* Evaluation of endgames that material alone gets wrong, looked up by the board's material key.
+ *
+ * Some signatures have an evaluator of their own (KBNK, KRKP) or scale the eval down (opposite
+ * coloured bishops), and a side without pawns that has at most one minor piece (or two knights)
+ * is never scored as winning, since it can't force mate.
+ */
+namespace endgame {
+    // Neither side can mate at all: bare kings, a single minor piece, or only bishops all on
+    // squares of the same colour. Such positions are dead draws.
+    bool insufficientMaterial(const Board& board);
+
+    // Takes the material eval from the point of view of the side to play and returns it corrected
+    // for the endgame, from the same point of view
+    int evaluate(const Board& board, const int materialEval);
+}
@@ -2,23 +2,37 @@
 #include "log.hpp"
 #include "timer.hpp"
 #include "utility.hpp"
+#include "tablebase.hpp"
+#include "endgame.hpp"
+#include "attacks.hpp"
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 
-Engine::Engine() {
-    board = Board();
-    
-    m_pieceValues[PieceType::PAWN] = 100;
-    m_pieceValues[PieceType::KNIGHT] = 300;
-    m_pieceValues[PieceType::BISHOP] = 350;
-    m_pieceValues[PieceType::ROOK] = 500;
-    m_pieceValues[PieceType::QUEEN] = 900;
-    m_pieceValues[PieceType::KING] = 1000000;
+Engine::Engine() : m_rng(std::random_device()()), m_stop(false), m_stack(MAX_PLY + 1), m_pv(MAX_PLY + 1) {
+    for (SearchFrame& frame : m_stack) {
+        frame.moves.reserve(256);
+        frame.orderedMoves.reserve(256);
+    }
 
+    board = Board();
     board.setPieceValues(m_pieceValues);
-    board.fillKnightAttacksArray();
-    board.fillKingMovesArray();
+
+    newGame();
+}
+
+Engine::~Engine() {
+    stopPondering();
+}
+
+void Engine::newGame() {
+    stopPondering();
+    m_tt.clear();
+    for (auto& side : m_history)
+        for (auto& from : side)
+            from.fill(0);
 }
 
 int Engine::evaluate() const {
@@ -27,87 +41,659 @@ int Engine::evaluate() const {
 
 
 int Engine::evaluate(const Board& board) const{
-    if (board.sideToPlay == Side::WHITE)
-        return board.materialDifference;
+    const Side us = board.sideToPlay;
+    const int material = (us == Side::WHITE) ? board.materialDifference : -board.materialDifference;
+    return endgame::evaluate(board, material + activity(board, us) - activity(board, opponentOf(us)));
+}
+
+int Engine::activity(const Board& board, const Side side) const {
+    constexpr uint64_t BLACK_HALF = 0xFFFFFFFF00000000ull;
+    const uint64_t squares = board.attackMaps.squares(side);
+    const uint64_t theirHalf = (side == Side::WHITE) ? BLACK_HALF : ~BLACK_HALF;
 
-    return -board.materialDifference;
+    const auto& counts = board.attackMaps.counts[(int)side];
+    const int king = board.kingSquare(opponentOf(side));
+    int kingZone = counts[king];
+    for (const int square : attacks::kingMoves[king]) kingZone += counts[square];
+
+    return MOBILITY * __builtin_popcountll(squares) + SPACE * __builtin_popcountll(squares & theirHalf)
+        + KING_PRESSURE * kingZone;
 }
 
-int Engine::search(Board& initialBoard, const int depth, int alpha, const int beta) {
-    if (depth == 0) return evaluate(initialBoard);
-    
+void Engine::updatePV(const int ply, const Move& move) {
+    m_pv[ply][ply] = move;
+    for (int i = ply + 1; i < m_pvLength[ply + 1]; i++) m_pv[ply][i] = m_pv[ply + 1][i];
+    m_pvLength[ply] = std::max(m_pvLength[ply + 1], ply + 1);
+}
+
+int Engine::evalToTT(const int eval, const int ply) const {
+    if (eval >= tablebaseBound) return eval + ply;
+    if (eval <= -tablebaseBound) return eval - ply;
+    return eval;
+}
+
+int Engine::evalFromTT(const int eval, const int ply) const {
+    if (eval >= tablebaseBound) return eval - ply;
+    if (eval <= -tablebaseBound) return eval + ply;
+    return eval;
+}
+
+int Engine::search(Board& initialBoard, const int depth, const int ply, int alpha, const int beta) {
+    m_pvLength[ply] = ply;
+    if (stopped()) return 0;
+    if (++m_nodes >= m_nodeBudget) m_outOfNodes = true;
+    if (ply > m_selDepth) m_selDepth = ply;
+    if (m_nodes % PROGRESS_NODES == 0) {
+        m_progress.nodes.store(m_nodes, std::memory_order_relaxed);
+        m_progress.selDepth.store(m_selDepth, std::memory_order_relaxed);
+        if (m_limitsPending.load(std::memory_order_relaxed)) takePendingLimits();
+        if (m_timed && std::chrono::steady_clock::now() >= m_deadline) m_outOfTime = true;
+    }
+
+    // nothing here can do better than mating on the next ply, or worse than being mated now
+    if (-infinity + ply >= beta) return beta;
+    if (infinity - ply - 1 <= alpha) return alpha;
+
+    // dead draws need no searching
+    if (endgame::insufficientMaterial(initialBoard)) return std::max(alpha, std::min(0, beta));
+
+    uint8_t tablebaseValue;
+    if (m_useTablebases && ply <= m_tablebasePly
+            && tablebase::countPieces(initialBoard) <= tablebase::MAX_PIECES
+            && tablebase::probe(initialBoard, tablebaseValue)) {
+        return std::max(alpha, std::min(tablebaseEval(tablebaseValue, ply), beta));
+    }
+
+    SearchFrame& frame = m_stack[ply];
+    frame.staticEval = evaluate(initialBoard);
+    if (depth == 0 || ply >= MAX_PLY) return frame.staticEval;
+
+    uint16_t ttMove = 0;
+    if (const TTEntry* entry = probeTT(initialBoard.hash)) {
+        ttMove = entry->move;
+        if (entry->depth >= depth) {
+            const int eval = evalFromTT(entry->eval, ply);
+            if (entry->bound == Bound::EXACT) return std::max(alpha, std::min(eval, beta));
+            if (entry->bound == Bound::LOWER && eval >= beta) return beta;
+            if (entry->bound == Bound::UPPER && eval <= alpha) return alpha;
+        }
+    }
     
-    std::vector<Move> moves;
-    initialBoard.generateAllMoves(moves);
+    frame.moves.clear();
+    initialBoard.generateAllMoves(frame.moves);
 
-    if (moves.size() == 0) {
-        if (initialBoard.check.at(initialBoard.sideToPlay)) return -infinity;
+    if (frame.moves.size() == 0) {
+        if (initialBoard.check.at(initialBoard.sideToPlay)) return -infinity + ply;
         Log(LogLevel::DEBUG, "Stalemate found");
         return 0;
     }
 
-    std::vector<Move> orderedMoves;
-    orderedMoves.reserve(moves.size());
-    orderMoves(moves, orderedMoves);
+    frame.orderedMoves.clear();
+    orderMoves(initialBoard, frame.moves, frame.orderedMoves, ttMove, &frame.killers);
+
+    Move bestMove;
+    for (const auto& move : frame.orderedMoves) {
+        frame.currentMove = move;
 
-    for (const auto& move : orderedMoves) {
         Board newBoard = initialBoard;
         newBoard.makeMove(move);
 
-        const int eval = -search(newBoard, depth-1, -beta, -alpha);
+        const int eval = -search(newBoard, depth-1, ply+1, -beta, -alpha);
+        if (stopped()) return 0;
 
         if (eval >= beta) {
+            if (!move.capture) {
+                m_history[(int)initialBoard.sideToPlay][move.before][move.after] += depth*depth;
+                if (move.encode() != frame.killers[0].encode()) {
+                    frame.killers[1] = frame.killers[0];
+                    frame.killers[0] = move;
+                }
+            }
+            m_tt.store(initialBoard.hash, depth, evalToTT(beta, ply), Bound::LOWER, move.encode());
             return beta;
         }
         if (eval > alpha) {
             alpha = eval;
+            bestMove = move;
+            updatePV(ply, move);
         }
     }
 
+    if (bestMove.beforeAndAfterDifferent())
+        m_tt.store(initialBoard.hash, depth, evalToTT(alpha, ply), Bound::EXACT, bestMove.encode());
+    else
+        m_tt.store(initialBoard.hash, depth, evalToTT(alpha, ply), Bound::UPPER, 0);
+
     return alpha;
 }
 
-void Engine::play() {    
-    std::vector<Move> moves;
-    board.generateAllMoves(moves);
+SearchResult Engine::iterativeDeepening(const Board& root, const int maxDepth, const uint64_t maxNodes, const int maxTime) {
+    SearchResult result;
+    m_nodes = 0;
+    m_maxDepth = maxDepth;
+    m_nodeBudget = (maxNodes != 0) ? maxNodes : UINT64_MAX;
+    m_outOfNodes = false;
+    m_timed = (maxTime > 0);
+    m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxTime);
+    m_outOfTime = false;
+    m_selDepth = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_progress.mutex);
+        m_progress.start = std::chrono::steady_clock::now();
+        m_progress.root = root;
+        m_progress.depth = 0;
+        m_progress.pv.clear();
+        m_progress.nodes = 0;
+        m_progress.selDepth = 0;
+    }
 
-    std::vector<Move> orderedMoves;
-    orderedMoves.reserve(moves.size());
-    orderMoves(moves, orderedMoves);
+    struct RootMove {
+        Move move;
+        int eval = 0;
+        bool exact = false;
+        uint64_t nodes = 0;
+        std::vector<Move> pv;   // from the triangular PV table, when the eval is exact
+    };
 
-    int bestEval = -infinity;
-    Move bestMove;
-    
-    Log(LogLevel::DEBUG, "Starting search");
+    // killers from an earlier search are for other positions
+    for (SearchFrame& frame : m_stack) frame.killers = {Move(), Move()};
+
+    std::vector<RootMove> rootMoves;
     {
-        //Timer timer;
+        std::vector<Move> moves;
+        root.generateAllMoves(moves);
+        if (moves.size() == 0) return result;
+
+        const TTEntry* entry = probeTT(root.hash);
+        std::vector<Move> orderedMoves;
+        orderedMoves.reserve(moves.size());
+        orderMoves(root, moves, orderedMoves, entry ? entry->move : 0);
+
         for (const Move& move : orderedMoves) {
-            Board newBoard = board;
-            newBoard.makeMove(move);
-
-            const int eval = -search(newBoard, m_depth, -infinity, infinity);
-            
-            if (eval > bestEval) {
-                bestEval = eval;
-                bestMove = move;
+            RootMove rootMove;
+            rootMove.move = move;
+            rootMoves.push_back(rootMove);
+        }
+    }
+
+    const size_t lines = std::min<size_t>(m_multiPV, rootMoves.size());
+    std::vector<RootMove> completed;    // rootMoves as the last complete iteration left them
+
+    if (m_useTablebases && searchTablebases(root, result)) return result;
+
+    // old history shouldn't outweigh what we learn in this search
+    for (auto& side : m_history)
+        for (auto& from : side)
+            for (int& score : from) score /= 2;
+
+    for (int depth = 0; depth <= m_maxDepth; depth++) {
+        // alpha is the eval of the worst of the best `lines` moves so far, so that every move
+        // which makes it into the top gets searched with a window wide enough for an exact eval
+        std::vector<int> topEvals;
+        int alpha = -infinity;
+
+        for (RootMove& rootMove : rootMoves) {
+            const uint64_t nodesBefore = m_nodes;
+
+            Board newBoard = root;
+            newBoard.makeMove(rootMove.move);
+
+            const int eval = -search(newBoard, depth, 1, -infinity, -alpha);
+            if (stopped()) {
+                // Out of nodes or time before the first iteration was done: the moves that were searched
+                // in it are all there is to choose from (the first one, if none were)
+                if (result.depth == 0 && !m_stop) {
+                    result.bestMove = rootMoves[0].move;
+                    result.eval = rootMoves[0].eval;
+                    for (const RootMove& searched : rootMoves) {
+                        if (&searched == &rootMove) break;
+                        if (searched.exact && searched.eval > result.eval) {
+                            result.bestMove = searched.move;
+                            result.eval = searched.eval;
+                        }
+                    }
+                }
+                break;
+            }
+
+            rootMove.eval = eval;
+            rootMove.exact = (eval > alpha || topEvals.size() < lines);
+            rootMove.nodes = m_nodes - nodesBefore;
+
+            rootMove.pv.assign(1, rootMove.move);
+            if (rootMove.exact) rootMove.pv.insert(rootMove.pv.end(), m_pv[1].begin() + 1, m_pv[1].begin() + m_pvLength[1]);
+
+            if (rootMove.exact) {
+                topEvals.insert(std::upper_bound(topEvals.begin(), topEvals.end(), eval, std::greater<int>()), eval);
+                if (topEvals.size() > lines) topEvals.pop_back();
+                if (topEvals.size() == lines) alpha = topEvals.back();
             }
         }
+
+        if (stopped()) break;  // keep the last complete iteration
+
+        // the first move stays in front if everything loses, so we always have something to play
+        std::stable_sort(rootMoves.begin(), rootMoves.end(), [](const RootMove& a, const RootMove& b) {
+            if (a.eval != b.eval) return a.eval > b.eval;
+            return a.exact && !b.exact;
+        });
+
+        m_tt.store(root.hash, depth+1, rootMoves[0].eval, Bound::EXACT, rootMoves[0].move.encode());
+        completed = rootMoves;
+        publishIteration(root, depth+1, rootMoves[0].eval, rootMoves[0].pv);
+
+        result.bestMove = rootMoves[0].move;
+        result.eval = rootMoves[0].eval;
+        result.depth = depth+1;
+        result.complete = (depth == m_maxDepth);
+
+        if (m_outOfNodes || m_outOfTime) break;
+    }
+    m_nodeBudget = UINT64_MAX;
+    m_timed = false;
+
+    result.nodes = m_nodes;
+    for (size_t i = 0; i < lines && i < completed.size(); i++) {
+        PrincipalVariation line;
+        line.eval = completed[i].eval;
+        line.nodes = completed[i].nodes;
+        line.moves = completed[i].pv;
+        extendPV(root, result.depth, line.moves);
+        result.lines.push_back(line);
+    }
+
+    return result;
+}
+
+int Engine::tablebaseEval(const uint8_t value, const int ply) const {
+    if (value == tablebase::DRAW) return 0;
+
+    // below mate (-infinity) but above anything material can add up to, shorter mates first. Like
+    // mate scores, the distance counts from the root.
+    const int distance = value - 1;
+    if (distance % 2 == 1) return infinity/2 - distance - ply;
+    return -infinity/2 + distance + ply;
+}
+
+bool Engine::searchTablebases(const Board& root, SearchResult& result) {
+    if (tablebase::countPieces(root) > tablebase::MAX_PIECES) return false;
+
+    uint8_t value;
+    if (!tablebase::probe(root, value)) return false;
+
+    std::vector<Move> moves;
+    root.generateAllMoves(moves);
+
+    std::vector<PrincipalVariation> lines;
+    for (const Move& move : moves) {
+        Board newBoard = root;
+        newBoard.makeMove(move);
+
+        PrincipalVariation line;
+        line.moves.push_back(move);
+
+        std::vector<Move> replies;
+        newBoard.generateAllMoves(replies);
+        if (replies.size() == 0) {
+            line.eval = newBoard.check.at(newBoard.sideToPlay) ? infinity - 1 : 0;   // mate in one ply
+        } else {
+            // every move out of a table lands in a table with the same or fewer pieces
+            if (!tablebase::probe(newBoard, value)) return false;
+            line.eval = -tablebaseEval(value, 1);
+        }
+        lines.push_back(line);
+    }
+
+    std::stable_sort(lines.begin(), lines.end(), [](const PrincipalVariation& a, const PrincipalVariation& b) {
+        return a.eval > b.eval;
+    });
+    lines.resize(std::min<size_t>(m_multiPV, lines.size()));
+
+    result.bestMove = lines[0].moves[0];
+    result.eval = lines[0].eval;
+    result.depth = 1;
+    result.complete = true;
+    result.lines = lines;
+    Log(LogLevel::INFO, "Tablebase hit at the root");
+    return true;
+}
+
+void Engine::setTablebases(const bool enabled) {
+    stopPondering();
+    m_useTablebases = enabled;
+}
+
+void Engine::setPieceValues(const PieceValues& values) {
+    stopPondering();
+    m_pieceValues = values;     // the board already points here
+    board.materialDifference = board.computeMaterialDifference();
+    m_tt.clear();
+    m_cache.reset();    // its evals were made with the old values too
+}
+
+uint64_t Engine::evaluationId() const {
+    // FNV-1a over everything evaluate() weighs
+    const int terms[] = {MOBILITY, SPACE, KING_PRESSURE};
+    uint64_t id = 0xcbf29ce484222325;
+    for (const int value : m_pieceValues.values) id = (id ^ (uint32_t) value) * 0x100000001b3;
+    for (const int value : terms) id = (id ^ (uint32_t) value) * 0x100000001b3;
+    return id;
+}
+
+bool Engine::saveCache(const std::string& path) {
+    stopPondering();
+    if (!SearchCache::save(path, m_tt, evaluationId(), m_cache)) return false;
+
+    Log(LogLevel::INFO, "Saved search cache to " + path);
+    return true;
+}
+
+bool Engine::loadCache(const std::string& path) {
+    stopPondering();
+    std::unique_ptr<SearchCache> cache = SearchCache::open(path, evaluationId());
+    if (!cache) return false;
+
+    m_cache = std::move(cache);
+    Log(LogLevel::INFO, "Search cache has " + std::to_string(m_cache->size()) + " entries");
+    return true;
+}
+
+const TTEntry* Engine::probeTT(const uint64_t key) const {
+    if (const TTEntry* entry = m_tt.probe(key)) return entry;
+    if (m_cache) return m_cache->probe(key);
+    return nullptr;
+}
+
+void Engine::extendPV(const Board& root, const int maxLength, std::vector<Move>& pv) const {
+    Board board = root;
+    for (const Move& move : pv) board.makeMove(move);
+
+    while ((int)pv.size() < maxLength) {
+        const TTEntry* entry = probeTT(board.hash);
+        if (entry == nullptr || entry->move == 0) return;
+
+        std::vector<Move> moves;
+        board.generateAllMoves(moves);
+
+        Move next;
+        for (const Move& move : moves) {
+            if (move.encode() == entry->move) next = move;
+        }
+        if (!next.beforeAndAfterDifferent()) return;
+
+        pv.push_back(next);
+        board.makeMove(next);
+    }
+}
+
+void Engine::printLines(const Board& root, const SearchResult& result) const {
+    for (size_t i = 0; i < result.lines.size(); i++) {
+        const PrincipalVariation& line = result.lines[i];
+
+        std::string pv;
+        Board board = root;
+        for (const Move& move : line.moves) {
+            pv += " " + algebraic(move, board.position);
+            board.makeMove(move);
+        }
+
+        std::cout << "$info multipv " << i+1 << " depth " << result.depth << " score " << line.eval
+                  << " nodes " << line.nodes << " pv" << pv << std::endl;
+    }
+}
+
+void Engine::publishIteration(const Board& root, const int depth, const int eval, const std::vector<Move>& pv) {
+    std::vector<Move> line = pv;
+    extendPV(root, depth, line);
+    const int hashfull = m_tt.hashfull();
+
+    std::lock_guard<std::mutex> lock(m_progress.mutex);
+    m_progress.depth = depth;
+    m_progress.eval = eval;
+    m_progress.hashfull = hashfull;
+    m_progress.pv = std::move(line);
+    m_progress.nodes.store(m_nodes, std::memory_order_relaxed);
+    m_progress.selDepth.store(m_selDepth, std::memory_order_relaxed);
+}
+
+void Engine::printProgress() {
+    Board board;
+    int depth, eval, hashfull;
+    std::vector<Move> pv;
+    std::chrono::steady_clock::time_point start;
+    {
+        std::lock_guard<std::mutex> lock(m_progress.mutex);
+        if (m_progress.depth == 0) return;  // nothing to show before the first iteration
+        board = m_progress.root;
+        depth = m_progress.depth;
+        eval = m_progress.eval;
+        hashfull = m_progress.hashfull;
+        pv = m_progress.pv;
+        start = m_progress.start;
+    }
+    const uint64_t nodes = m_progress.nodes.load(std::memory_order_relaxed);
+    const int selDepth = std::max(m_progress.selDepth.load(std::memory_order_relaxed), depth);
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    std::string line = "$info depth " + std::to_string(depth) + " seldepth " + std::to_string(selDepth)
+        + " score " + std::to_string(eval) + " nodes " + std::to_string(nodes)
+        + " nps " + std::to_string(nodes * 1000 / std::max<int64_t>(ms, 1)) + " hashfull " + std::to_string(hashfull)
+        + " time " + std::to_string(ms) + " pv";
+    for (const Move& move : pv) {
+        line += " " + algebraic(move, board.position);
+        board.makeMove(move);
+    }
+    std::cout << line << std::endl;
+}
+
+void Engine::startReporter() {
+    if (m_infoInterval == 0) return;
+
+    m_reporterStop = false;
+    m_reporterThread = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(m_reporterMutex);
+        while (!m_reporterWake.wait_for(lock, std::chrono::milliseconds(m_infoInterval), [this]() { return m_reporterStop; })) {
+            printProgress();
+        }
+    });
+}
+
+void Engine::stopReporter() {
+    if (!m_reporterThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_reporterMutex);
+        m_reporterStop = true;
+    }
+    m_reporterWake.notify_one();
+    m_reporterThread.join();
+}
+
+void Engine::play(const SearchLimits& limits) {
+    Move bookMove;
+    if (m_book && m_book->probe(board, bookMove, m_bookBestMove, m_rng)) {
+        stopPondering();
+        Log(LogLevel::INFO, "Book move");
+        std::cout << algebraic(bookMove, board.position) << std::endl;
+        board.makeMove(bookMove);
+        return;
+    }
+
+    SearchResult result;
+    bool searched = false;
+    const int maxDepth = maxDepthFor(limits);
+
+    // on a ponderhit this reports the ponder search as it finishes
+    startReporter();
+    if (m_ponderThread.joinable()) {
+        if (m_ponderBoard.hash == board.hash) {
+            // ponderhit: the search is already on the right position, so let it carry on under this
+            // move's limits instead of starting over
+            Log(LogLevel::INFO, "Ponderhit");
+            setPendingLimits(maxDepth, limits);
+            m_ponderThread.join();
+            // if it finished before taking the limits up, it went to the ponder depth and no further
+            m_limitsPending = false;
+
+            // a ponder search that got deeper than limits.depth would make $play depth N depend on pondering
+            const bool finished = m_outOfNodes || m_outOfTime || (m_ponderResult.complete && m_maxDepth == maxDepth);
+            if (finished && !(limits.depth > 0 && m_ponderResult.depth > limits.depth)) {
+                result = m_ponderResult;
+                searched = true;
+            } else {
+                Log(LogLevel::INFO, "Ponder search doesn't fit the limits");
+            }
+        } else {
+            Log(LogLevel::INFO, "Ponder miss");
+            stopPondering();
+        }
+    }
+
+    Log(LogLevel::DEBUG, "Starting search");
+    if (!searched) {
+        //Timer timer;
+        result = iterativeDeepening(board, maxDepth, limits.nodes, limits.time);
     }
     Log(LogLevel::DEBUG, "Search complete");
+    stopReporter();
 
+    printLines(board, result);
+    std::cout << "$info depth " << result.depth << " nodes " << result.nodes << std::endl;
 
-    if (bestMove.beforeAndAfterDifferent()) {
-        std::cout << algebraic(bestMove, board.position) << std::endl;  // TEMPORARY
-        board.makeMove(bestMove);
+    if (result.bestMove.beforeAndAfterDifferent()) {
+        std::cout << algebraic(result.bestMove, board.position) << std::endl;
+        board.makeMove(result.bestMove);
     } else {
         Log(LogLevel::INFO, "No moves found");
     }
     Log(LogLevel::INFO, board.materialDifference);
+    Log(LogLevel::INFO, "Hashfull " + std::to_string(m_tt.hashfull()));
+
+    if (m_ponderEnabled) startPondering();
+}
+
+SearchResult Engine::analyse(const SearchLimits& limits) {
+    stopPondering();
+
+    return iterativeDeepening(board, maxDepthFor(limits), limits.nodes, limits.time);
+}
+
+int Engine::maxDepthFor(const SearchLimits& limits) const {
+    // iterativeDeepening's depth counts from 0, limits.depth in plies
+    if (limits.depth > 0) return limits.depth - 1;
+    if (limits.nodes > 0 || limits.time > 0) return MAX_PLY - 1;   // the node or time limit ends the search
+    return m_depth;
+}
+
+void Engine::setPondering(const bool enabled) {
+    m_ponderEnabled = enabled;
+    if (!enabled) stopPondering();
+}
+
+void Engine::setInfoInterval(const int ms) {
+    m_infoInterval = std::max(0, ms);
+}
+
+void Engine::setMultiPV(const int lines) {
+    stopPondering();    // a ponder result with the wrong number of lines would be no use
+    m_multiPV = std::max(1, lines);
+}
+
+bool Engine::setBook(const std::string& path) {
+    if (path.empty()) {
+        m_book = nullptr;
+        return true;
+    }
+
+    m_book = OpeningBook::open(path);
+    if (!m_book) {
+        Log(LogLevel::WARN, "Couldn't open book " + path);
+        return false;
+    }
+
+    Log(LogLevel::INFO, "Book has " + std::to_string(m_book->entries()) + " entries");
+    return true;
 }
 
-void Engine::orderMoves(const std::vector<Move>& moves, std::vector<Move>& orderedMoves) {
+void Engine::setBookBestMove(const bool best) {
+    m_bookBestMove = best;
+}
+
+void Engine::startPondering() {
+    stopPondering();
+
+    // the expected reply is whatever the last search thought was best for the opponent
+    const TTEntry* entry = probeTT(board.hash);
+    if (entry == nullptr || entry->move == 0) return;
+
+    std::vector<Move> moves;
+    board.generateAllMoves(moves);
+
     for (const Move& move : moves) {
-        if (move.capture) orderedMoves.push_back(move);
+        if (move.encode() == entry->move) {
+            m_ponderBoard = board;
+            m_ponderBoard.makeMove(move);
+            m_ponderResult = SearchResult();
+
+            Log(LogLevel::INFO, "Pondering on " + algebraic(move, board.position));
+            m_ponderThread = std::thread([this]() {
+                m_ponderResult = iterativeDeepening(m_ponderBoard, m_depth);
+            });
+            return;
+        }
+    }
+}
+
+void Engine::setPendingLimits(const int maxDepth, const SearchLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_pendingLimits.maxDepth = maxDepth;
+    m_pendingLimits.nodes = limits.nodes;
+    m_pendingLimits.time = limits.time;
+    m_pendingLimits.start = std::chrono::steady_clock::now();
+    m_limitsPending = true;
+}
+
+void Engine::takePendingLimits() {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_maxDepth = m_pendingLimits.maxDepth;
+    m_nodeBudget = (m_pendingLimits.nodes != 0) ? m_nodes + m_pendingLimits.nodes : UINT64_MAX;
+    m_timed = (m_pendingLimits.time > 0);
+    m_deadline = m_pendingLimits.start + std::chrono::milliseconds(m_pendingLimits.time);
+    m_limitsPending = false;
+}
+
+void Engine::stopPondering() {
+    if (!m_ponderThread.joinable()) return;
+
+    m_stop = true;
+    m_ponderThread.join();
+    m_stop = false;
+}
+
+void Engine::orderMoves(
+    const Board& board,
+    const std::vector<Move>& moves,
+    std::vector<Move>& orderedMoves,
+    const uint16_t ttMove,
+    const std::array<Move, 2>* killers
+    ) const {
+    // best move from an earlier search first, then captures, then killers, then quiet moves by history
+    for (const Move& move : moves) {
+        if (ttMove != 0 && move.encode() == ttMove) orderedMoves.push_back(move);
+    }
+    for (const Move& move : moves) {
+        if (move.capture && move.encode() != ttMove) orderedMoves.push_back(move);
+    }
+
+    const auto isKiller = [&](const Move& move) {
+        if (killers == nullptr || move.capture || move.encode() == ttMove) return false;
+        return move.encode() == (*killers)[0].encode() || move.encode() == (*killers)[1].encode();
+    };
+    if (killers != nullptr) {
+        for (const Move& killer : *killers) {
+            for (const Move& move : moves) {
+                if (move.encode() == killer.encode() && isKiller(move)) orderedMoves.push_back(move);
+            }
+        }
     }
     /* for (const Move& move : moves) {
         if (!move.capture && move.willBeCheck) orderedMoves.push_back(move);
@@ -115,12 +701,73 @@ void Engine::orderMoves(const std::vector<Move>& moves, std::vector<Move>& order
     for (const Move& move : moves) {
         if (!move.capture && !move.willBeCheck) orderedMoves.push_back(move);
     } */
+    const size_t firstQuiet = orderedMoves.size();
     for (const Move& move : moves) {
-        if (!move.capture) orderedMoves.push_back(move);
+        if (!move.capture && move.encode() != ttMove && !isKiller(move)) orderedMoves.push_back(move);
     }
+
+    const auto& history = m_history[(int)board.sideToPlay];
+    // ties go by the encoding rather than the order the generator happens to produce moves in
+    std::sort(orderedMoves.begin() + firstQuiet, orderedMoves.end(), [&](const Move& a, const Move& b) {
+        const int historyA = history[a.before][a.after], historyB = history[b.before][b.after];
+        if (historyA != historyB) return historyA > historyB;
+        return a.encode() < b.encode();
+    });
 }
 
 
+//==========================================================================
+// Benchmark
+void Engine::bench(const int depth) {
+    stopPondering();
+
+    const std::vector<std::string> positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+    };
+    const Board savedBoard = board;
+    const int savedMultiPV = m_multiPV;
+    std::unique_ptr<SearchCache> savedCache = std::move(m_cache);    // so runs are comparable
+
+    uint64_t baseNodes = 0;
+    double baseMs = 0;
+
+    for (int multiPV = 1; multiPV <= 4; multiPV++) {
+        m_multiPV = multiPV;
+        uint64_t nodes = 0;
+        double ms = 0;
+
+        for (const std::string& fen : positions) {
+            newGame();
+            loadFEN(fen, board);
+
+            const auto start = std::chrono::steady_clock::now();
+            nodes += iterativeDeepening(board, depth).nodes;
+            ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        if (multiPV == 1) {
+            baseNodes = nodes;
+            baseMs = ms;
+        }
+
+        std::cout << "$bench multipv " << multiPV << " nodes " << nodes << " time " << (int)ms << " ms"
+                  << " nps " << (uint64_t)(nodes / std::max(ms, 1.0) * 1000);
+        if (multiPV > 1) {
+            std::cout << " cost per extra line: nodes +" << (int)(100.0 * (nodes - baseNodes) / baseNodes / (multiPV-1)) << "%"
+                      << " time +" << (int)(100.0 * (ms - baseMs) / std::max(baseMs, 1.0) / (multiPV-1)) << "%";
+        }
+        std::cout << std::endl;
+    }
+
+    m_multiPV = savedMultiPV;
+    m_cache = std::move(savedCache);
+    newGame();
+    board = savedBoard;
+}
+
 //==========================================================================
 // Perft stuff
 void Engine::countMoves(const int depth) const {
@@ -160,4 +807,23 @@ void Engine::countMoves(const Board& board, std::unordered_map<int, MoveCounter>
 
         }
     }
-}
\ No newline at end of file
+}
+
+uint64_t Engine::perft(const int depth) const {
+    if (depth <= 0) return 1;
+    return perft(board, depth);
+}
+
+uint64_t Engine::perft(const Board& board, const int depth) const {
+    std::vector<Move> moves;
+    board.generateAllMoves(moves);
+    if (depth == 1) return moves.size();
+
+    uint64_t nodes = 0;
+    for (const Move& move : moves) {
+        Board newBoard = board;
+        newBoard.makeMove(move);
+        nodes += perft(newBoard, depth-1);
+    }
+    return nodes;
+}
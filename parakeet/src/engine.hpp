@@ -1,33 +1,196 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <random>
 
 #include "board.hpp"
+#include "transpositiontable.hpp"
+#include "book.hpp"
+#include "searchcache.hpp"
 #include "types/movecounter.hpp"
 
+// One of the MultiPV lines at the root. The eval is exact for the lines that get reported.
+struct PrincipalVariation {
+    std::vector<Move> moves;
+    int eval = 0;
+    uint64_t nodes = 0;     // nodes spent below the first move in the last iteration
+};
+
+struct SearchResult {
+    Move bestMove;
+    int eval = 0;
+    int depth = 0;          // depth of the last completed iteration
+    bool complete = false;  // false if the search was stopped before reaching full depth
+    uint64_t nodes = 0;
+    std::vector<PrincipalVariation> lines;  // best first, as many as the MultiPV setting
+};
+
+// Limits for analyse() and play(). 0 means no limit; without any the engine's default depth is used.
+// A single-threaded search without a time limit doesn't depend on the clock, so the same position,
+// settings and limits always give the same move, eval and node count (with pondering off and no
+// weighted book moves).
+struct SearchLimits {
+    int depth = 0;
+    uint64_t nodes = 0;     // the search stops after exactly this many, keeping the last complete iteration
+    int time = 0;           // ms, checked every few thousand nodes; like nodes, keeps the last complete iteration
+};
+
 class Engine {
 public:
     Board board;
 
 private:
 
-    std::unordered_map<PieceType, int> m_pieceValues;
+    PieceValues m_pieceValues = DEFAULT_PIECE_VALUES;  // the board points at these
 
-    const int m_depth = 5;
+    int m_depth = 5;
+    int m_multiPV = 1;
 
     const int infinity = 1000000;
 
-    void initZobristKeys();
+    // Being mated scores -infinity plus the plies from the root, so sooner mates score further from 0.
+    // Scores beyond mateBound are mates and those beyond tablebaseBound (but not mateBound) are
+    // tablebase wins. In the transposition table they count from the position stored instead of the
+    // root (evalToTT and evalFromTT convert).
+    const int mateBound = infinity - 1000;
+    const int tablebaseBound = infinity/2 - 1000;
+    int evalToTT(const int eval, const int ply) const;
+    int evalFromTT(const int eval, const int ply) const;
+
+    // Terms on top of material, read off the board's attack maps, in centipawns per square attacked
+    static constexpr int MOBILITY = 2;          // anywhere
+    static constexpr int SPACE = 2;             // in the opponent's half, on top of MOBILITY
+    static constexpr int KING_PRESSURE = 6;     // per attacker of the opponent's king or a square next to it
+    int activity(const Board& board, const Side side) const;
+
+    uint64_t m_nodes = 0;
+    uint64_t m_nodeBudget = UINT64_MAX;    // search stops when m_nodes reaches it
+    bool m_outOfNodes = false;
+    bool m_timed = false;
+    std::chrono::steady_clock::time_point m_deadline;   // when m_timed
+    bool m_outOfTime = false;
+    bool stopped() const { return m_outOfNodes || m_outOfTime || m_stop.load(std::memory_order_relaxed); }
+    int m_maxDepth = 0;     // of the running iterativeDeepening; new limits can change it
+    int m_selDepth = 0;     // deepest ply the search has reached
+
+    // What the running search has got to, for the info lines play() prints while it searches. The
+    // search only stores counts (every PROGRESS_NODES nodes) and each complete iteration; the
+    // reporter thread turns them into text, at most once every m_infoInterval ms.
+    struct Progress {
+        std::mutex mutex;   // for everything but the atomics
+        std::chrono::steady_clock::time_point start;
+        Board root;
+        int depth = 0;      // of the last complete iteration, 0 before the first
+        int eval = 0;
+        int hashfull = 0;
+        std::vector<Move> pv;
+        std::atomic<uint64_t> nodes{0};
+        std::atomic<int> selDepth{0};
+    };
+    static constexpr uint64_t PROGRESS_NODES = 4096;
+    Progress m_progress;
+    void publishIteration(const Board& root, const int depth, const int eval, const std::vector<Move>& pv);
+
+    int m_infoInterval = 1000;  // 0 for no info lines while searching
+    std::thread m_reporterThread;
+    std::mutex m_reporterMutex;
+    std::condition_variable m_reporterWake;
+    bool m_reporterStop = false;
+    void startReporter();
+    void stopReporter();
+    void printProgress();
+
+    // Endgame tablebases are probed at the root and up to m_tablebasePly plies below it
+    bool m_useTablebases = true;
+    const int m_tablebasePly = 4;
+    int tablebaseEval(const uint8_t value, const int ply) const;
+    bool searchTablebases(const Board& root, SearchResult& result);
+
+    // Opening book, consulted by play() before searching
+    std::shared_ptr<const OpeningBook> m_book;
+    bool m_bookBestMove = false;
+    std::mt19937 m_rng;
+
+    // Search state that survives between moves of the same game (cleared by newGame)
+    TranspositionTable m_tt;
+    std::array<std::array<std::array<int, 64>, 64>, 2> m_history;   // [side][before][after]
+
+    // Results of earlier sessions, loaded from a snapshot. Unlike m_tt it survives newGame.
+    std::unique_ptr<SearchCache> m_cache;
+    // m_tt first, then the cache
+    const TTEntry* probeTT(const uint64_t key) const;
+    // Identifies the piece values and evaluation terms, so a snapshot made with others isn't loaded
+    uint64_t evaluationId() const;
+
+    // Pondering: after play() we keep searching the position after the expected reply
+    bool m_ponderEnabled = false;
+    std::thread m_ponderThread;
+    std::atomic<bool> m_stop;
+    Board m_ponderBoard;
+    SearchResult m_ponderResult;    // only read after m_ponderThread has been joined
+
+    // Limits handed to the ponder search on a ponderhit. The search takes them up every
+    // PROGRESS_NODES nodes, counting the nodes from there and the time from when they were set.
+    struct PendingLimits {
+        int maxDepth = 0;
+        uint64_t nodes = 0;
+        int time = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::mutex m_pendingMutex;
+    PendingLimits m_pendingLimits;
+    std::atomic<bool> m_limitsPending{false};
+    void setPendingLimits(const int maxDepth, const SearchLimits& limits);
+    void takePendingLimits();
+
+    // The search stack: one frame per ply, allocated with the engine so that search doesn't allocate
+    static constexpr int MAX_PLY = 64;
+    struct SearchFrame {
+        std::vector<Move> moves;
+        std::vector<Move> orderedMoves;
+        Move currentMove;
+        int staticEval = 0;
+        std::array<Move, 2> killers;    // quiet moves that caused a beta cutoff at this ply, newest first
+    };
+    std::vector<SearchFrame> m_stack;   // MAX_PLY + 1 frames
+
+    // Triangular PV table: row ply holds the best line found from ply on, up to m_pvLength[ply]
+    std::vector<std::array<Move, MAX_PLY + 1>> m_pv;
+    std::array<int, MAX_PLY + 1> m_pvLength;
+    void updatePV(const int ply, const Move& move);
 
-    int evaluate(const Board& board) const;
     int search(
         Board& initialBoard,
         const int depth,
+        const int ply,
         int alpha,
         const int beta
     );
-    
-    void orderMoves(const std::vector<Move>& moves, std::vector<Move>& orderedMoves);
+    SearchResult iterativeDeepening(const Board& root, const int maxDepth, const uint64_t maxNodes = 0, const int maxTime = 0);
+    // iterativeDeepening's maxDepth for the limits
+    int maxDepthFor(const SearchLimits& limits) const;
+
+    // lengthens a PV cut short (e.g. by a transposition table hit) by following the table after it
+    void extendPV(const Board& root, const int maxLength, std::vector<Move>& pv) const;
+    void printLines(const Board& root, const SearchResult& result) const;
+
+    void orderMoves(
+        const Board& board,
+        const std::vector<Move>& moves,
+        std::vector<Move>& orderedMoves,
+        const uint16_t ttMove = 0,
+        const std::array<Move, 2>* killers = nullptr
+    ) const;
+
+    void startPondering();
 
     // perft
     void countMoves(
@@ -35,12 +198,53 @@ private:
         std::unordered_map<int, MoveCounter>& countersPerDepth,
         const int depth=1
     ) const;
+    uint64_t perft(const Board& board, const int depth) const;
 
 public:
     Engine();
+    ~Engine();
 
     int evaluate() const;
-    void play();
+    // static evaluation from the point of view of the side to play
+    int evaluate(const Board& board) const;
+    // Plays the best move. Limits replace the engine's depth, and on a ponderhit they apply to the
+    // ponder search from then on.
+    void play(const SearchLimits& limits = SearchLimits());
+
+    // Searches the current position without playing a move
+    SearchResult analyse(const SearchLimits& limits);
+
+    // Forget everything learned about the previous game. Call when the board is set up from scratch.
+    void newGame();
+
+    void setPondering(const bool enabled);
+    void setMultiPV(const int lines);
+    // How often play() prints the progress of its search, in ms. 0 turns it off.
+    void setInfoInterval(const int ms);
+
+    // Returns false if the book can't be opened. An empty path turns the book off.
+    bool setBook(const std::string& path);
+    // Always play the book move with the highest weight instead of picking by weight
+    void setBookBestMove(const bool best);
+
+    void setTablebases(const bool enabled);
+
+    // Changes the material values (e.g. to ones from parakeet tune). Forgets the transposition table and
+    // the search cache, whose evals were made with the old values.
+    void setPieceValues(const PieceValues& values);
+    const PieceValues& getPieceValues() const { return m_pieceValues; }
+
+    // Snapshot the transposition table (together with the loaded cache) to a file, or load one made
+    // by this build with the same piece values. Both return false on failure. After saving, the
+    // loaded cache (if any) is the new snapshot.
+    bool saveCache(const std::string& path);
+    bool loadCache(const std::string& path);
+    void stopPondering();
 
     void countMoves(const int depth=1) const;
-};
\ No newline at end of file
+    // number of leaf nodes of the move tree, without printing anything
+    uint64_t perft(const int depth) const;
+
+    // Searches a fixed set of positions and reports nodes and time, including the extra cost of MultiPV
+    void bench(const int depth=4);
+};
@@ -0,0 +1,4 @@
+#include "log.hpp"
+
+// set by whoever uses the engine (main sets it from the command line)
+LogLevel LOG_LEVEL = LogLevel::ERROR;
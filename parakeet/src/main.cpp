@@ -1,28 +1,48 @@
 #include "main.hpp"
 #include "utility.hpp"
 #include "engine.hpp"
+#include "tablebase.hpp"
+#include "matesolver.hpp"
+#include "batch.hpp"
+#include "dataset.hpp"
+#include "selfplay.hpp"
+#include "match.hpp"
+#include "server.hpp"
+#include "tune.hpp"
 #include "log.hpp"
 
 #include <iostream>
 #include <exception>
-
-LogLevel LOG_LEVEL;
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
 
 int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        std::string arg1 = argv[1];
-        if (arg1 == "debug") LOG_LEVEL = LogLevel::DEBUG;
-        else if (arg1 == "info") LOG_LEVEL = LogLevel::INFO;
-        else if (arg1 == "warn") LOG_LEVEL = LogLevel::WARN;
+    if (argc >= 2 && std::string(argv[1]) == "batch") return batch::run(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "pack") return dataset::pack(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "unpack") return dataset::unpack(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "selfplay") return selfplay::run(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "match") return match::run(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "serve") return server::run(argc - 2, argv + 2);
+    if (argc >= 2 && std::string(argv[1]) == "tune") return tune::run(argc - 2, argv + 2);
+
+    // arguments: an optional log level, and cache=<file> to start with a search cache made by $savecache
+    std::string cachePath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "debug") LOG_LEVEL = LogLevel::DEBUG;
+        else if (arg == "info") LOG_LEVEL = LogLevel::INFO;
+        else if (arg == "warn") LOG_LEVEL = LogLevel::WARN;
+        else if (arg.rfind("cache=", 0) == 0) cachePath = arg.substr(6);
         else {
-            throw std::invalid_argument("Unknown debug level. Acceptable levels are debug, info and warn.");
+            throw std::invalid_argument("Unknown argument. Acceptable arguments are the levels debug, info and warn, and cache=<file>.");
         }
     }
 
-    run();
+    run(cachePath);
 }
 
-static void run() {
+static void run(const std::string& cachePath) {
     /* This function communicates with the user to control the engine.
      * All user commands begin with a dollar sign $
      * 
@@ -48,10 +68,32 @@ static void run() {
      * $testmovegen     test move generation (count moves in given position)
      * $exitboard       exit the current board
      * $getposition     prints the current position
-     * $play            calculates what move it thinks best, plays it and displays it
+     * $play            calculates what move it thinks best, plays it and displays it (after its expected line)
+     * $play nodes N    the same, searching exactly N nodes (the same move and node count on any machine)
+     * $play depth N    the same, searching N plies deep
+     * $play time N     the same, searching for about N milliseconds
+     * $ponder on|off   keep thinking about the expected reply while waiting for the opponent's move
+     * $multipv [n]     report the best n moves with their evals and lines when playing
+     * $infointerval [ms] while playing, print the search's progress every ms milliseconds (0 for never)
+     * $book [file]     use a Polyglot opening book, $book off to stop using it
+     * $bookmode best|weighted  always play the most common book move or pick by weight
+     * $tb on|off       use endgame tablebases (on by default, if they've been generated)
+     * $tbpath [dir]    directory the tablebases are kept in
+     * $tbgen [material] generate the tablebase for e.g. KRKP (and any it depends on)
+     * $tbbench [materials] generate tablebases and time generation and probing
+     * $bench           search a fixed set of positions and report nodes, time and the cost of MultiPV
+     * $legalmoves     print every legal move (UCI), who is in check and whether the game is over, on one line
+     * $values [file]  load piece values written by parakeet tune, or print the ones in use
+     * $fen            print the current position as a FEN
+     * $fenbench       time reading and writing FENs
+     * $perft [depth]  count the leaf nodes of the move tree to that depth and time it
+     * $mate [moves]   look for a forced mate in at most that many moves, giving check every move
+     * $savecache [file] save what the engine has searched so far, to be reused in later sessions
+     * $loadcache [file] load a file made by $savecache (only accepted from the same build)
      */
 
     Engine engine;
+    if (!cachePath.empty()) engine.loadCache(cachePath);
     std::unordered_map<unsigned short, std::vector<Move>> generatedMoves;
 
     enum Mode {
@@ -73,14 +115,20 @@ static void run() {
 
                 if (in == "$reset") {
                     engine.board.reset();
+                    engine.newGame();
                     mode = RUNNING;
                 } else if (in == "$testmovegen") {
                     mode = TEST_MOVE_GEN;
                 } else if (in == "$quit") {
                     quit = true;  
                 } else {
-                    loadFEN(in, engine.board);
-                    mode = RUNNING;
+                    const char* error = nullptr;
+                    if (loadFEN(in, engine.board, &error)) {
+                        engine.newGame();
+                        mode = RUNNING;
+                    } else {
+                        Log(LogLevel::ERROR, std::string("Invalid FEN: ") + error);
+                    }
                 }
             } break;
             
@@ -91,6 +139,7 @@ static void run() {
                 if (in[0] == '$') { // commands
                     if (in == "$reset") {
                         engine.board.reset();
+                        engine.newGame();
                     } else if (in == "$quit") {
                         quit = true;
                     } else if (in == "$testmovegen") {
@@ -101,6 +150,105 @@ static void run() {
                         std::cout << getPositionString(engine.board) << std::endl;
                     } else if (in == "$play") {
                         engine.play();
+                    } else if (in.rfind("$play nodes ", 0) == 0) {
+                        SearchLimits limits;
+                        limits.nodes = std::max(stoll(in.substr(12)), 1LL);
+                        engine.play(limits);
+                    } else if (in.rfind("$play depth ", 0) == 0) {
+                        SearchLimits limits;
+                        limits.depth = std::clamp(stoi(in.substr(12)), 1, 64);
+                        engine.play(limits);
+                    } else if (in.rfind("$play time ", 0) == 0) {
+                        SearchLimits limits;
+                        limits.time = std::max(stoi(in.substr(11)), 1);
+                        engine.play(limits);
+                    } else if (in == "$ponder on") {
+                        engine.setPondering(true);
+                    } else if (in == "$ponder off") {
+                        engine.setPondering(false);
+                    } else if (in.rfind("$multipv ", 0) == 0) {
+                        engine.setMultiPV(stoi(in.substr(9)));
+                    } else if (in.rfind("$infointerval ", 0) == 0) {
+                        engine.setInfoInterval(stoi(in.substr(14)));
+                    } else if (in == "$book off") {
+                        engine.setBook("");
+                    } else if (in.rfind("$book ", 0) == 0) {
+                        engine.setBook(in.substr(6));
+                    } else if (in == "$bookmode best") {
+                        engine.setBookBestMove(true);
+                    } else if (in == "$bookmode weighted") {
+                        engine.setBookBestMove(false);
+                    } else if (in == "$tb on") {
+                        engine.setTablebases(true);
+                    } else if (in == "$tb off") {
+                        engine.setTablebases(false);
+                    } else if (in.rfind("$tbpath ", 0) == 0) {
+                        engine.stopPondering();     // the tables a ponder search probes are about to go
+                        tablebase::setPath(in.substr(8));
+                    } else if (in.rfind("$tbgen ", 0) == 0) {
+                        engine.stopPondering();     // generating replaces the tables it probes
+                        tablebase::GenerationStats stats;
+                        tablebase::generate(in.substr(7), stats);
+                    } else if (in.rfind("$tbbench", 0) == 0) {
+                        engine.stopPondering();
+                        tablebase::bench(in.size() > 9 ? in.substr(9) : "KPK KRK KQK");
+                    } else if (in == "$bench") {
+                        engine.bench();
+                    } else if (in == "$legalmoves") {
+                        std::vector<Move> moves;
+                        engine.board.generateAllMoves(moves);
+
+                        const Side side = engine.board.sideToPlay;
+                        const bool inCheck = engine.board.check.at(side);
+
+                        std::string status = "ongoing";
+                        if (moves.empty()) status = inCheck ? "checkmate" : "stalemate";
+
+                        std::cout << "$legalmoves check " << (inCheck ? (side == Side::WHITE ? "white" : "black") : "none")
+                                  << " status " << status << " moves";
+                        for (const Move& move : moves) std::cout << " " << uci(move);
+                        std::cout << std::endl;
+                    } else if (in == "$values") {
+                        std::cout << "$values " << pieceValuesString(engine.getPieceValues()) << std::endl;
+                    } else if (in.rfind("$values ", 0) == 0) {
+                        PieceValues values = engine.getPieceValues();
+                        if (readPieceValues(in.substr(8), values)) engine.setPieceValues(values);
+                        else Log(LogLevel::ERROR, "Couldn't load piece values from " + in.substr(8));
+                    } else if (in == "$fen") {
+                        std::cout << "$fen " << getFEN(engine.board) << std::endl;
+                    } else if (in == "$fenbench") {
+                        benchFEN();
+                    } else if (in.rfind("$mate ", 0) == 0) {
+                        const int maxMoves = std::clamp(stoi(in.substr(6)), 1, 32);
+                        const auto start = std::chrono::steady_clock::now();
+                        MateSolver solver;
+                        const MateResult result = solver.solve(engine.board, maxMoves);
+                        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                        std::cout << "$mate ";
+                        if (result.found) std::cout << result.moves;
+                        else std::cout << (result.complete ? "none" : "unknown");
+                        std::cout << " nodes " << result.nodes << " time " << (int) ms;
+                        if (result.found) {
+                            std::cout << " pv";
+                            Board board = engine.board;
+                            for (const Move& move : result.line) {
+                                std::cout << " " << algebraic(move, board.position);
+                                board.makeMove(move);
+                            }
+                        }
+                        std::cout << std::endl;
+                    } else if (in.rfind("$perft ", 0) == 0) {
+                        const int depth = stoi(in.substr(7));
+                        const auto start = std::chrono::steady_clock::now();
+                        const uint64_t nodes = engine.perft(depth);
+                        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                        std::cout << "$perft depth " << depth << " nodes " << nodes << " time " << (int) ms
+                                  << " nps " << (uint64_t) (nodes / std::max(ms, 1.0) * 1000) << std::endl;
+                    } else if (in.rfind("$savecache ", 0) == 0) {
+                        engine.saveCache(in.substr(11));
+                    } else if (in.rfind("$loadcache ", 0) == 0) {
+                        engine.loadCache(in.substr(11));
                     }
                     
                 } else {    // move given
@@ -154,6 +302,7 @@ static void run() {
                 if (in[0] == '$') { // commands
                     if (in == "$reset") {
                         engine.board.reset();
+                        engine.newGame();
                     } else if (in == "$quit") {
                         quit = true;
                     } else if (in == "$exitboard") {
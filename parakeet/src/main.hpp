@@ -1,3 +1,5 @@
 #pragma once
 
-static void run();
\ No newline at end of file
+#include <string>
+
+static void run(const std::string& cachePath);
\ No newline at end of file
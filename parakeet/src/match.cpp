@@ -0,0 +1,352 @@
+#include "match.hpp"
+#include "engine.hpp"
+#include "book.hpp"
+#include "endgame.hpp"
+#include "utility.hpp"
+#include "log.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+namespace match {
+namespace {
+    constexpr int A = 0, B = 1;
+
+    struct Player {
+        PieceValues values = DEFAULT_PIECE_VALUES;
+        SearchLimits limits;
+    };
+
+    struct Settings {
+        uint64_t games = 1000;
+        std::array<Player, 2> players;      // A and B
+        std::vector<std::string> openings;  // FENs, played in turn. Empty for book and random moves.
+        std::shared_ptr<const OpeningBook> book;
+        int randomPlies = 8;
+        uint64_t seed = 1;
+
+        // the SPRT: H0 is that A is elo0 stronger than B, H1 that it is elo1 stronger
+        double elo0 = 0, elo1 = 5;
+        double alpha = 0.05, beta = 0.05;   // the chances of accepting H1 when H0 holds, and H0 when H1 does
+    };
+
+    struct PlayerStats {
+        uint64_t searches = 0;
+        uint64_t nodes = 0;
+        uint64_t depth = 0;     // summed over the searches
+        double seconds = 0;     // spent searching
+    };
+
+    // for A
+    struct Score {
+        uint64_t wins = 0, draws = 0, losses = 0;
+        uint64_t games() const { return wins + draws + losses; }
+    };
+
+    // games that go on longer than this are called drawn
+    constexpr int MAX_PLIES = 400;
+
+    // Adjudication, on the scores of both engines' searches (from white's point of view). A game is
+    // drawn when they stay close to 0 for DRAW_PLIES plies in a row after DRAW_FROM_PLY, and won when
+    // they agree for RESIGN_PLIES plies in a row that one side is RESIGN_SCORE ahead.
+    constexpr int DRAW_FROM_PLY = 80;
+    constexpr int DRAW_SCORE = 10;
+    constexpr int DRAW_PLIES = 8;
+    constexpr int RESIGN_SCORE = 600;
+    constexpr int RESIGN_PLIES = 6;
+
+    // expected score for an Elo difference, and back
+    double expectedScore(const double elo) {
+        return 1 / (1 + std::pow(10.0, -elo / 400));
+    }
+    double eloOf(double score) {
+        score = std::clamp(score, 1e-6, 1 - 1e-6);     // all wins or losses are a finite, if silly, estimate
+        return 400 * std::log10(score / (1 - score));
+    }
+
+    // Log-likelihood ratio of H1 to H0 from the wins, draws and losses (the normal approximation of
+    // the generalised SPRT, as fishtest and cutechess use for game results)
+    double llr(const Score& score, const double elo0, const double elo1) {
+        const double games = score.games();
+        if (games == 0) return 0;
+
+        const double win = score.wins / games, draw = score.draws / games;
+        const double mean = win + draw / 2;
+        const double variance = win + draw / 4 - mean * mean;
+        if (variance <= 0) return 0;
+
+        const double score0 = expectedScore(elo0), score1 = expectedScore(elo1);
+        return games * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+    }
+
+    // A's Elo and the half width of its 95% confidence interval
+    void elo(const Score& score, double& estimate, double& margin) {
+        const double games = std::max<double>(score.games(), 1);
+        const double win = score.wins / games, draw = score.draws / games;
+        const double mean = win + draw / 2;
+        const double deviation = std::sqrt(std::max(win + draw / 4 - mean * mean, 0.0) / games);
+
+        estimate = eloOf(mean);
+        margin = (eloOf(mean + 1.96 * deviation) - eloOf(mean - 1.96 * deviation)) / 2;
+    }
+
+    void report(const Score& score, const Settings& settings) {
+        double estimate, margin;
+        elo(score, estimate, margin);
+        const double lower = std::log(settings.beta / (1 - settings.alpha));
+        const double upper = std::log((1 - settings.beta) / settings.alpha);
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "$match games " << score.games() << " a " << score.wins << " draws " << score.draws << " b " << score.losses
+                  << " elo " << estimate << " +- " << margin << std::setprecision(2)
+                  << " llr " << llr(score, settings.elo0, settings.elo1) << " (" << lower << ", " << upper << ")" << std::endl;
+    }
+
+    // Plays the same moves on both engines' boards (which each have their own piece values)
+    void makeMove(const std::array<Engine*, 2>& engines, const Move& move, std::vector<uint64_t>& hashes) {
+        for (Engine* engine : engines) engine->board.makeMove(move);
+        hashes.push_back(engines[A]->board.hash);
+    }
+
+    // Sets up the opening of a pair of games. Returns false if the book and random moves end the game.
+    bool playOpening(const std::array<Engine*, 2>& engines, const Settings& settings, const uint64_t pair,
+                     std::mt19937& rng, std::vector<uint64_t>& hashes) {
+        if (!settings.openings.empty()) {
+            for (Engine* engine : engines) loadFEN(settings.openings[pair % settings.openings.size()], engine->board);
+            hashes = {engines[A]->board.hash};
+            return true;
+        }
+
+        for (Engine* engine : engines) engine->board.reset();
+        hashes = {engines[A]->board.hash};
+
+        Move bookMove;
+        while (settings.book && settings.book->probe(engines[A]->board, bookMove, false, rng)) makeMove(engines, bookMove, hashes);
+
+        std::vector<Move> moves;
+        for (int ply = 0; ply <= settings.randomPlies; ply++) {
+            moves.clear();
+            engines[A]->board.generateAllMoves(moves);
+            if (moves.empty()) return false;
+            if (ply == settings.randomPlies) break;     // only checking the game isn't over
+
+            makeMove(engines, moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)], hashes);
+        }
+        return true;
+    }
+
+    // Plays game `number`: the opening of pair number/2, with A white in even games. Returns the result
+    // for A (1, 0 or -1).
+    int playGame(const std::array<Engine*, 2>& engines, const Settings& settings, const uint64_t number,
+                 std::array<PlayerStats, 2>& stats) {
+        const uint64_t pair = number / 2;
+        const int white = (number % 2 == 0) ? A : B;
+        const auto forA = [white](const int whiteResult) { return (white == A) ? whiteResult : -whiteResult; };
+
+        for (Engine* engine : engines) engine->newGame();
+
+        // both games of a pair get the same opening, from the same random sequence
+        std::seed_seq seed{settings.seed, pair};
+        std::mt19937 rng(seed);
+        std::vector<uint64_t> hashes;
+        for (int tries = 0; !playOpening(engines, settings, pair, rng, hashes); tries++) {
+            if (tries == 100) return 0;
+        }
+
+        int drawPlies = 0, resignPlies = 0, resignSign = 0;
+        std::vector<Move> moves;
+        for (int ply = 0; ply < MAX_PLIES; ply++) {
+            const Board& board = engines[A]->board;
+
+            moves.clear();
+            board.generateAllMoves(moves);
+            if (moves.empty()) {
+                if (!board.check.at(board.sideToPlay)) return 0;
+                return forA((board.sideToPlay == Side::WHITE) ? -1 : 1);
+            }
+            if (board.halfmoveClock >= 100 || endgame::insufficientMaterial(board)) return 0;
+            if (std::count(hashes.begin(), hashes.end(), board.hash) >= 3) return 0;
+
+            const int mover = (board.sideToPlay == Side::WHITE) ? white : 1 - white;
+            const auto start = std::chrono::steady_clock::now();
+            const SearchResult result = engines[mover]->analyse(settings.players[mover].limits);
+            stats[mover].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats[mover].searches++;
+            stats[mover].nodes += result.nodes;
+            stats[mover].depth += result.depth;
+
+            const int score = (board.sideToPlay == Side::WHITE) ? result.eval : -result.eval;
+            drawPlies = (ply >= DRAW_FROM_PLY && std::abs(score) <= DRAW_SCORE) ? drawPlies + 1 : 0;
+            if (drawPlies >= DRAW_PLIES) return 0;
+
+            const int sign = (score >= RESIGN_SCORE) ? 1 : (score <= -RESIGN_SCORE) ? -1 : 0;
+            resignPlies = (sign != 0 && sign == resignSign) ? resignPlies + 1 : (sign != 0);
+            resignSign = sign;
+            if (resignPlies >= RESIGN_PLIES) return forA(sign);
+
+            makeMove(engines, result.bestMove, hashes);
+        }
+        return 0;
+    }
+
+    // EPD or FEN lines, of which the position and any clocks are used
+    bool readOpenings(const std::string& path, std::vector<std::string>& out) {
+        std::ifstream file(path);
+        if (!file) {
+            Log(LogLevel::ERROR, "Couldn't open " + path);
+            return false;
+        }
+
+        std::string line;
+        for (int number = 1; std::getline(file, line); number++) {
+            std::istringstream stream(line);
+            std::vector<std::string> fields;
+            std::string field;
+            while (fields.size() < 6 && stream >> field) fields.push_back(field);
+            if (fields.empty() || fields[0][0] == '#') continue;
+
+            const auto isNumber = [](const std::string& text) { return text.find_first_not_of("0123456789") == std::string::npos; };
+            if (fields.size() == 6 && !(isNumber(fields[4]) && isNumber(fields[5]))) fields.resize(4);
+            else if (fields.size() == 5) fields.resize(4);
+
+            std::string fen;
+            for (const std::string& part : fields) fen += (fen.empty() ? "" : " ") + part;
+
+            Board board;
+            const char* error = nullptr;
+            if (!loadFEN(fen, board, &error)) {
+                Log(LogLevel::ERROR, path + " line " + std::to_string(number) + ": " + (error ? error : "invalid FEN"));
+                return false;
+            }
+            out.push_back(fen);
+        }
+        if (out.empty()) Log(LogLevel::ERROR, "No openings in " + path);
+        return !out.empty();
+    }
+}
+
+int run(int argc, char* argv[]) {
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    Settings settings;
+    SearchLimits limits;    // for both, unless given for one
+
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string key = arg.substr(0, equals), value = (equals == std::string::npos) ? "" : arg.substr(equals + 1);
+        try {
+            if (key == "games") settings.games = std::stoull(value);
+            else if (key == "threads") threads = std::max(1, std::stoi(value));
+            else if (key == "depth") limits.depth = std::stoi(value);
+            else if (key == "nodes") limits.nodes = std::stoull(value);
+            else if (key == "a.depth") settings.players[A].limits.depth = std::stoi(value);
+            else if (key == "a.nodes") settings.players[A].limits.nodes = std::stoull(value);
+            else if (key == "b.depth") settings.players[B].limits.depth = std::stoi(value);
+            else if (key == "b.nodes") settings.players[B].limits.nodes = std::stoull(value);
+            else if (key == "random") settings.randomPlies = std::max(0, std::stoi(value));
+            else if (key == "seed") settings.seed = std::stoull(value);
+            else if (key == "elo0") settings.elo0 = std::stod(value);
+            else if (key == "elo1") settings.elo1 = std::stod(value);
+            else if (key == "alpha") settings.alpha = std::stod(value);
+            else if (key == "beta") settings.beta = std::stod(value);
+            else if (key == "a" || key == "b") {
+                if (!readPieceValues(value, settings.players[key == "a" ? A : B].values)) {
+                    Log(LogLevel::ERROR, "Couldn't load piece values from " + value);
+                    return 1;
+                }
+            }
+            else if (key == "openings") {
+                if (!readOpenings(value, settings.openings)) return 1;
+            }
+            else if (key == "book") {
+                settings.book = OpeningBook::open(value);
+                if (!settings.book) {
+                    Log(LogLevel::ERROR, "Couldn't open book " + value);
+                    return 1;
+                }
+            }
+            else throw std::invalid_argument(arg);
+        } catch (const std::exception&) {
+            Log(LogLevel::ERROR, "Bad match argument " + arg);
+            Log(LogLevel::ERROR, "Usage: parakeet match [games=N] [threads=N] [depth=N] [nodes=N] [a=<values>] [b=<values>] "
+                "[a.depth=N] [a.nodes=N] [b.depth=N] [b.nodes=N] [openings=<file>] [book=<file>] [random=N] [seed=N] "
+                "[elo0=X] [elo1=X] [alpha=X] [beta=X]");
+            return 1;
+        }
+    }
+    if (limits.depth == 0 && limits.nodes == 0) limits.depth = 4;
+    for (Player& player : settings.players) {
+        if (player.limits.depth == 0 && player.limits.nodes == 0) player.limits = limits;
+    }
+    if (settings.alpha <= 0 || settings.alpha >= 1 || settings.beta <= 0 || settings.beta >= 1 || settings.elo0 >= settings.elo1) {
+        Log(LogLevel::ERROR, "The SPRT needs 0 < alpha, beta < 1 and elo0 < elo1");
+        return 1;
+    }
+    const double lower = std::log(settings.beta / (1 - settings.alpha));
+    const double upper = std::log((1 - settings.beta) / settings.alpha);
+
+    std::atomic<uint64_t> nextGame{0};
+    std::atomic<bool> decided{false};
+    std::mutex scoreMutex;
+    Score score;
+    std::vector<std::array<PlayerStats, 2>> stats(threads);
+
+    const auto worker = [&](std::array<PlayerStats, 2>& threadStats) {
+        const auto a = std::make_unique<Engine>(), b = std::make_unique<Engine>();
+        a->setPieceValues(settings.players[A].values);
+        b->setPieceValues(settings.players[B].values);
+        const std::array<Engine*, 2> engines = {a.get(), b.get()};
+
+        for (uint64_t number = nextGame++; number < settings.games && !decided; number = nextGame++) {
+            const int result = playGame(engines, settings, number, threadStats);
+
+            std::lock_guard<std::mutex> lock(scoreMutex);
+            if (result > 0) score.wins++;
+            else if (result < 0) score.losses++;
+            else score.draws++;
+
+            const double ratio = llr(score, settings.elo0, settings.elo1);
+            if (ratio <= lower || ratio >= upper) decided = true;
+            if (score.games() % 100 == 0 && !decided) report(score, settings);
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; i++) workers.emplace_back(worker, std::ref(stats[i]));
+    for (std::thread& thread : workers) thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const int player : {A, B}) {
+        PlayerStats total;
+        for (const auto& thread : stats) {
+            total.searches += thread[player].searches;
+            total.nodes += thread[player].nodes;
+            total.depth += thread[player].depth;
+            total.seconds += thread[player].seconds;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "$match " << (player == A ? "a" : "b")
+                  << " searches " << total.searches << " nps " << (uint64_t) (total.nodes / std::max(total.seconds, 0.001))
+                  << " depth " << (double) total.depth / std::max<uint64_t>(total.searches, 1) << "\n";
+    }
+    report(score, settings);
+
+    const double ratio = llr(score, settings.elo0, settings.elo1);
+    std::cout << "$match sprt " << (ratio >= upper ? "H1" : ratio <= lower ? "H0" : "none")
+              << " time " << (int) (seconds * 1000) << " ms" << std::endl;
+    return 0;
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+/* Engine against engine matches:
+ *     parakeet match [games=N] [threads=N] [depth=N] [nodes=N] [a=<values>] [b=<values>]
+ *                    [a.depth=N] [a.nodes=N] [b.depth=N] [b.nodes=N] [openings=<file>] [book=<file>]
+ *                    [random=N] [seed=N] [elo0=X] [elo1=X] [alpha=X] [beta=X]
+ *
+ * Plays two engine configurations against each other in-process: A (the candidate) and B (the
+ * baseline), each with its own piece values (files as written by parakeet tune) and search limits.
+ * Games run on a pool of worker threads, each with an Engine for either side. Every opening (a
+ * line of an EPD/FEN file, or book moves followed by random plies) is played twice, with the
+ * colours swapped. Games that are clearly drawn or lost are adjudicated.
+ *
+ * A sequential probability ratio test of elo0 against elo1 (A's Elo over B) stops the match as
+ * soon as one of them is accepted. The result is A's Elo with a 95% error bar, and the nodes per
+ * second and average depth of each side.
+ */
+namespace match {
+    // argv without the program name and "match". Returns the exit code.
+    int run(int argc, char* argv[]);
+}
@@ -0,0 +1,183 @@
+#include "matesolver.hpp"
+
+#include <algorithm>
+#include <climits>
+
+MateSolver::MateSolver(const size_t sizeInMB)
+    : m_capacity(std::max<size_t>(sizeInMB * 1024 * 1024 / sizeof(Node), 1)) {
+    m_moves.reserve(256);
+}
+
+MateResult MateSolver::solve(const Board& root, const int maxMoves) {
+    MateResult result;
+    m_nodes.reserve(m_capacity);    // never grows past this, so references into it stay valid
+
+    for (int moves = 1; moves <= maxMoves; moves++) {
+        const Outcome outcome = search(root, moves);
+        result.nodes += m_nodes.size();
+
+        if (outcome == Outcome::FULL) {
+            result.complete = false;
+            break;
+        }
+        if (outcome == Outcome::NO_MATE) continue;
+
+        result.found = true;
+        result.moves = moves;
+
+        // the attacker takes the quickest mate in the tree, the defender puts it off the longest
+        std::vector<int> distances(m_nodes.size(), -1);
+        uint32_t index = 0;
+        for (int ply = 0; m_nodes[index].children > 0; ply++) {
+            const Node& node = m_nodes[index];
+            uint32_t best = 0;
+            int bestDistance = 0;
+            for (uint32_t child = node.firstChild; child < node.firstChild + node.children; child++) {
+                if (m_nodes[child].proof != 0) continue;
+                const int childDistance = distance(child, ply+1, distances);
+                if (best == 0 || (ply % 2 == 0 ? childDistance < bestDistance : childDistance > bestDistance)) {
+                    best = child;
+                    bestDistance = childDistance;
+                }
+            }
+            result.line.push_back(m_nodes[best].move);
+            index = best;
+        }
+        break;
+    }
+
+    return result;
+}
+
+MateSolver::Outcome MateSolver::search(const Board& root, const int moves) {
+    m_nodes.clear();
+    m_nodes.emplace_back();
+
+    while (m_nodes[0].proof != 0 && m_nodes[0].disproof != 0) {
+        // Walk down to the most proving node: where the attacker moves, the child with the smallest
+        // proof number, where the defender moves, the one with the smallest disproof number
+        Board board = root;
+        uint32_t index = 0;
+        int ply = 0;
+        while (m_nodes[index].expanded) {
+            const Node& node = m_nodes[index];
+            uint32_t next = node.firstChild;
+            for (uint32_t child = node.firstChild + 1; child < node.firstChild + node.children; child++) {
+                if (ply % 2 == 0 ? m_nodes[child].proof < m_nodes[next].proof
+                                 : m_nodes[child].disproof < m_nodes[next].disproof) next = child;
+            }
+            board.makeMove(m_nodes[next].move);
+            index = next;
+            ply++;
+        }
+
+        if (!expand(index, board, ply, moves)) return Outcome::FULL;
+
+        // and back up again, until the numbers stop changing
+        while (index != 0) {
+            index = m_nodes[index].parent;
+            ply--;
+
+            const uint32_t proof = m_nodes[index].proof;
+            const uint32_t disproof = m_nodes[index].disproof;
+            update(index, ply);
+            if (m_nodes[index].proof == proof && m_nodes[index].disproof == disproof) break;
+        }
+    }
+
+    return m_nodes[0].proof == 0 ? Outcome::MATE : Outcome::NO_MATE;
+}
+
+bool MateSolver::expand(const uint32_t index, const Board& board, const int ply, const int moves) {
+    Node& node = m_nodes[index];
+    node.expanded = true;
+
+    const bool attacker = (ply % 2 == 0);
+
+    m_moves.clear();
+    if (!attacker || ply / 2 < moves) board.generateAllMoves(m_moves);
+
+    if (attacker) {
+        m_moves.erase(std::remove_if(m_moves.begin(), m_moves.end(), [](const Move& move) {
+            return !move.willBeCheck;
+        }), m_moves.end());
+
+        if (m_moves.empty()) {  // out of checks (or of moves allowed)
+            node.proof = INFINITE;
+            node.disproof = 0;
+            return true;
+        }
+    } else {
+        if (m_moves.empty()) {
+            const bool mate = board.check.at(board.sideToPlay);
+            node.proof = mate ? 0 : INFINITE;
+            node.disproof = mate ? INFINITE : 0;
+            return true;
+        }
+        if (ply == 2*moves - 1) {   // the defender gets out of it, and the attacker has no moves left
+            node.proof = INFINITE;
+            node.disproof = 0;
+            return true;
+        }
+    }
+
+    if (m_nodes.size() + m_moves.size() > m_capacity) return false;
+
+    node.firstChild = m_nodes.size();
+    node.children = m_moves.size();
+    for (const Move& move : m_moves) {
+        Node child;
+        child.move = move;
+        child.parent = index;
+        m_nodes.push_back(child);
+    }
+
+    update(index, ply);
+    return true;
+}
+
+void MateSolver::update(const uint32_t index, const int ply) {
+    Node& node = m_nodes[index];
+    if (node.children == 0) return;     // decided when it was expanded
+
+    // where the attacker moves one mating child is enough, where the defender moves all of them have to be
+    uint64_t sum = 0;
+    uint32_t smallest = INFINITE;
+    for (uint32_t child = node.firstChild; child < node.firstChild + node.children; child++) {
+        const Node& childNode = m_nodes[child];
+        if (ply % 2 == 0) {
+            smallest = std::min(smallest, childNode.proof);
+            sum += childNode.disproof;
+        } else {
+            smallest = std::min(smallest, childNode.disproof);
+            sum += childNode.proof;
+        }
+    }
+
+    const uint32_t total = (uint32_t) std::min<uint64_t>(sum, INFINITE);
+    if (ply % 2 == 0) {
+        node.proof = smallest;
+        node.disproof = total;
+    } else {
+        node.proof = total;
+        node.disproof = smallest;
+    }
+}
+
+int MateSolver::distance(const uint32_t index, const int ply, std::vector<int>& distances) const {
+    if (distances[index] >= 0) return distances[index];
+
+    const Node& node = m_nodes[index];
+    int out = 0;    // a leaf that's proven is a mate
+    if (node.children > 0) {
+        out = (ply % 2 == 0) ? INT_MAX : 0;
+        for (uint32_t child = node.firstChild; child < node.firstChild + node.children; child++) {
+            if (m_nodes[child].proof != 0) continue;
+            const int childDistance = distance(child, ply+1, distances) + 1;
+            out = (ply % 2 == 0) ? std::min(out, childDistance) : std::max(out, childDistance);
+        }
+    }
+
+    distances[index] = out;
+    return out;
+}
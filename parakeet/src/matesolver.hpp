@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "board.hpp"
+
+struct MateResult {
+    bool found = false;
+    bool complete = true;   // false if the node table filled up before the search was decided
+    int moves = 0;          // mate in this many moves of the side to play
+    std::vector<Move> line; // both sides' moves, ending with the mate
+    uint64_t nodes = 0;     // nodes created, over all iterations
+};
+
+/* Looks for forced mates with proof-number search, in which the side to play only gives check.
+ *
+ * The tree is kept in a node table of fixed size. Each node has a proof number (how many leaves
+ * would have to turn out to be mates to prove it) and a disproof number (the same for escapes),
+ * and the leaf that proves or disproves the most at once is expanded next. The search is run with
+ * the number of moves bounded to 1, 2, ... so that the first mate found is the shortest.
+ */
+class MateSolver {
+public:
+    MateSolver(const size_t sizeInMB = 64);
+
+    // Searches for a mate in at most maxMoves moves
+    MateResult solve(const Board& root, const int maxMoves);
+
+private:
+    static constexpr uint32_t INFINITE = 1000000000;
+
+    struct Node {
+        Move move;                  // the move that led here
+        uint32_t proof = 1;
+        uint32_t disproof = 1;
+        uint32_t parent = 0;
+        uint32_t firstChild = 0;    // children are next to each other in the table
+        uint16_t children = 0;
+        bool expanded = false;
+    };
+
+    enum class Outcome {
+        MATE, NO_MATE, FULL
+    };
+
+    // Proves or disproves a mate in `moves` for the root (m_nodes[0])
+    Outcome search(const Board& root, const int moves);
+
+    // Adds the node's children, or decides it if it has none. Returns false if the table is full.
+    bool expand(const uint32_t index, const Board& board, const int ply, const int moves);
+    // Works the proof and disproof numbers of the node out again from its children
+    void update(const uint32_t index, const int ply);
+
+    // plies to mate with best play from a proven node, for picking the line to report
+    int distance(const uint32_t index, const int ply, std::vector<int>& distances) const;
+
+    size_t m_capacity;
+    std::vector<Node> m_nodes;
+    std::vector<Move> m_moves;  // scratch for move generation
+};
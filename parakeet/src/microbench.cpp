@@ -0,0 +1,436 @@
+/* Microbenchmarks of the Board hot paths, built as bin/parakeet-bench:
+ *     parakeet-bench [runs=N] [filter=<name>] [json=<file>] [label=<text>] [compare=<file>]
+ *
+ * Every benchmark goes over the same corpus of positions (from short games played with a fixed seed),
+ * is warmed up, and is then timed runs times. The median and percentiles of the time per call are
+ * reported, and on Linux also hardware counters per call if perf_event_open is allowed.
+ * json= writes the results (label= names the run, e.g. with a commit), and compare= prints the change
+ * of the medians against such a file.
+ */
+#include "board.hpp"
+#include "engine.hpp"
+#include "utility.hpp"
+#include "log.hpp"
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace {
+    struct Counters {
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t branchMisses = 0;
+        uint64_t cacheMisses = 0;
+
+        void operator+=(const Counters& other) {
+            cycles += other.cycles;
+            instructions += other.instructions;
+            branchMisses += other.branchMisses;
+            cacheMisses += other.cacheMisses;
+        }
+    };
+
+    // A group of hardware counters for this thread, read together. Not available everywhere
+    // (other systems, containers, perf_event_paranoid), in which case only times are reported.
+    class PerfCounters {
+    public:
+        PerfCounters() {
+#ifdef __linux__
+            const uint64_t configs[COUNTERS] = {
+                PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+            };
+            for (int i = 0; i < COUNTERS; i++) {
+                perf_event_attr attributes;
+                std::memset(&attributes, 0, sizeof(attributes));
+                attributes.size = sizeof(attributes);
+                attributes.type = PERF_TYPE_HARDWARE;
+                attributes.config = configs[i];
+                attributes.disabled = (i == 0);
+                attributes.exclude_kernel = 1;
+                attributes.exclude_hv = 1;
+                attributes.read_format = PERF_FORMAT_GROUP;
+
+                m_files[i] = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, (i == 0) ? -1 : m_files[0], 0);
+                if (m_files[i] < 0) {
+                    m_error = std::strerror(errno);
+                    close();
+                    return;
+                }
+            }
+            m_available = true;
+#else
+            m_error = "only on Linux";
+#endif
+        }
+
+        ~PerfCounters() { close(); }
+
+        bool available() const { return m_available; }
+        const std::string& error() const { return m_error; }
+
+        void start() {
+#ifdef __linux__
+            if (!m_available) return;
+            ioctl(m_files[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(m_files[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+        }
+
+        Counters stop() {
+            Counters out;
+#ifdef __linux__
+            if (!m_available) return out;
+            ioctl(m_files[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+            uint64_t values[1 + COUNTERS];     // number of counters, then their values
+            if (read(m_files[0], values, sizeof(values)) != (ssize_t) sizeof(values)) return out;
+            out.cycles = values[1];
+            out.instructions = values[2];
+            out.branchMisses = values[3];
+            out.cacheMisses = values[4];
+#endif
+            return out;
+        }
+
+    private:
+        static constexpr int COUNTERS = 4;
+        int m_files[COUNTERS] = {-1, -1, -1, -1};
+        bool m_available = false;
+        std::string m_error;
+
+        void close() {
+#ifdef __linux__
+            for (int& file : m_files) {
+                if (file >= 0) ::close(file);
+                file = -1;
+            }
+#endif
+        }
+    };
+
+    struct Game {
+        Board start;
+        std::vector<Move> moves;
+    };
+
+    struct Corpus {
+        std::vector<Game> games;
+        std::vector<Board> positions;               // every position of every game
+        std::vector<std::vector<Move>> legalMoves;  // of each position
+    };
+
+    Corpus makeCorpus() {
+        const std::vector<std::string> fens = {
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+            "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+            "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+            "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+            "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+            "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+            "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+            "8/8/4k3/8/2pP4/8/6K1/8 b - d3 0 1"
+        };
+
+        Corpus corpus;
+        std::mt19937 rng(2024);   // fixed, so every run times the same positions
+        std::vector<Move> moves;
+
+        for (const std::string& fen : fens) {
+            for (int game = 0; game < 8; game++) {
+                Game out;
+                loadFEN(fen, out.start);
+
+                Board board = out.start;
+                for (int ply = 0; ply < 60; ply++) {
+                    moves.clear();
+                    board.generateAllMoves(moves);
+                    if (moves.empty()) break;
+
+                    corpus.positions.push_back(board);
+                    corpus.legalMoves.push_back(moves);
+
+                    const Move move = moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)];
+                    out.moves.push_back(move);
+                    board.makeMove(move);
+                }
+                corpus.games.push_back(std::move(out));
+            }
+        }
+        return corpus;
+    }
+
+    struct Benchmark {
+        std::string name;
+        // one pass over the corpus. Returns the number of calls it made, and adds to sink so the
+        // compiler can't leave the work out.
+        std::function<uint64_t(uint64_t& sink)> pass;
+    };
+
+    struct Result {
+        std::string name;
+        uint64_t calls = 0;             // per run
+        std::vector<double> nsPerCall;  // one per run, sorted
+        Counters counters;              // over all the timed runs
+        bool hasCounters = false;
+
+        double percentile(const double p) const {
+            const double index = p * (nsPerCall.size() - 1);
+            const size_t low = (size_t) index;
+            const size_t high = std::min(low + 1, nsPerCall.size() - 1);
+            return nsPerCall[low] + (nsPerCall[high] - nsPerCall[low]) * (index - low);
+        }
+    };
+
+    double elapsedNs(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    Result measure(const Benchmark& benchmark, const int runs, PerfCounters& perf, uint64_t& sink) {
+        // warm up (caches, branch predictors, clock speed) for at least 100 ms, and work out how many
+        // passes make a run long enough (20 ms) to time well
+        uint64_t callsPerPass = 0;
+        int passes = 0;
+        const auto warmUp = std::chrono::steady_clock::now();
+        while (passes < 3 || elapsedNs(warmUp) < 100e6) {
+            callsPerPass = benchmark.pass(sink);
+            passes++;
+        }
+        const double passNs = elapsedNs(warmUp) / passes;
+        const int passesPerRun = std::max(1, (int) std::ceil(20e6 / passNs));
+
+        Result result;
+        result.name = benchmark.name;
+        result.calls = callsPerPass * passesPerRun;
+        result.hasCounters = perf.available();
+
+        for (int run = 0; run < runs; run++) {
+            perf.start();
+            const auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < passesPerRun; pass++) benchmark.pass(sink);
+            const double ns = elapsedNs(start);
+            result.counters += perf.stop();
+
+            result.nsPerCall.push_back(ns / result.calls);
+        }
+        std::sort(result.nsPerCall.begin(), result.nsPerCall.end());
+        return result;
+    }
+
+    // The medians of an earlier json= file, by benchmark name
+    std::vector<std::pair<std::string, double>> readMedians(const std::string& path) {
+        std::vector<std::pair<std::string, double>> out;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            const size_t name = line.find("\"name\": \"");
+            const size_t median = line.find("\"median\": ");
+            if (name == std::string::npos || median == std::string::npos) continue;
+
+            const size_t nameStart = name + 9;
+            out.emplace_back(line.substr(nameStart, line.find('"', nameStart) - nameStart),
+                             std::stod(line.substr(median + 10)));
+        }
+        return out;
+    }
+
+    std::string jsonEscape(const std::string& text) {
+        std::string out;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    void writeJson(const std::string& path, const std::string& label, const int runs, const size_t positions,
+                   const std::vector<Result>& results) {
+        std::ofstream out(path);
+        out << std::fixed << std::setprecision(3);
+        out << "{\n";
+        out << "  \"label\": \"" << jsonEscape(label) << "\",\n";
+        out << "  \"build\": \"" << __DATE__ << " " << __TIME__ << "\",\n";
+        out << "  \"runs\": " << runs << ",\n";
+        out << "  \"positions\": " << positions << ",\n";
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            // one benchmark per line, which readMedians depends on
+            out << "    {\"name\": \"" << result.name << "\", \"calls\": " << result.calls
+                << ", \"min\": " << result.nsPerCall.front() << ", \"p10\": " << result.percentile(0.1)
+                << ", \"median\": " << result.percentile(0.5) << ", \"p90\": " << result.percentile(0.9)
+                << ", \"max\": " << result.nsPerCall.back();
+            if (result.hasCounters) {
+                const double calls = (double) result.calls * runs;
+                out << ", \"cycles\": " << result.counters.cycles / calls
+                    << ", \"instructions\": " << result.counters.instructions / calls
+                    << ", \"branch_misses\": " << result.counters.branchMisses / calls
+                    << ", \"cache_misses\": " << result.counters.cacheMisses / calls;
+            }
+            out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        if (!out.good()) Log(LogLevel::ERROR, "Couldn't write " + path);
+    }
+}
+
+// Board lets this class at its private helpers
+class MicroBench {
+public:
+    static void addMoveIfAcceptable(const Board& board, std::vector<Move>& moves, const Move& move) {
+        const PieceType type = board.position[move.before].type;
+        const bool isKing = type == PieceType::KING, isKnight = type == PieceType::KNIGHT;
+        if (board.sideToPlay == Side::WHITE)
+            board.addMoveIfAcceptable<Side::WHITE>(moves, move, isKing, isKnight, move.isEnPassant());
+        else
+            board.addMoveIfAcceptable<Side::BLACK>(moves, move, isKing, isKnight, move.isEnPassant());
+    }
+};
+
+int main(int argc, char* argv[]) {
+    int runs = 15;
+    std::string filter, jsonPath, label, comparePath;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg.rfind("runs=", 0) == 0) runs = std::max(1, std::atoi(arg.c_str() + 5));
+        else if (arg.rfind("filter=", 0) == 0) filter = arg.substr(7);
+        else if (arg.rfind("json=", 0) == 0) jsonPath = arg.substr(5);
+        else if (arg.rfind("label=", 0) == 0) label = arg.substr(6);
+        else if (arg.rfind("compare=", 0) == 0) comparePath = arg.substr(8);
+        else {
+            Log(LogLevel::ERROR, "Usage: parakeet-bench [runs=N] [filter=<name>] [json=<file>] [label=<text>] [compare=<file>]");
+            return 1;
+        }
+    }
+
+    const Corpus corpus = makeCorpus();
+    const std::vector<Board>& positions = corpus.positions;
+    Engine engine;
+
+    std::vector<Move> scratch;
+    scratch.reserve(256);
+
+    const std::vector<Benchmark> benchmarks = {
+        {"Board::makeMove", [&](uint64_t& sink) {
+            uint64_t calls = 0;
+            for (const Game& game : corpus.games) {
+                Board board = game.start;   // one copy per game, spread over its moves
+                for (const Move& move : game.moves) board.makeMove(move);
+                sink += board.hash;
+                calls += game.moves.size();
+            }
+            return calls;
+        }},
+        {"Board::generateAllMoves", [&](uint64_t& sink) {
+            for (const Board& board : positions) {
+                scratch.clear();
+                board.generateAllMoves(scratch);
+                sink += scratch.size();
+            }
+            return (uint64_t) positions.size();
+        }},
+        {"Board::generateMoves", [&](uint64_t& sink) {
+            uint64_t calls = 0;
+            for (const Board& board : positions) {
+                for (int square = 0; square < 64; square++) {
+                    if (board.position[square].side != board.sideToPlay) continue;
+                    scratch.clear();
+                    board.generateMoves(square, scratch);
+                    sink += scratch.size();
+                    calls++;
+                }
+            }
+            return calls;
+        }},
+        {"Board::sideInCheck", [&](uint64_t& sink) {
+            for (const Board& board : positions) {
+                sink += board.sideInCheck(Side::WHITE);
+                sink += board.sideInCheck(Side::BLACK);
+            }
+            return (uint64_t) positions.size() * 2;
+        }},
+        {"Board::addMoveIfAcceptable", [&](uint64_t& sink) {
+            uint64_t calls = 0;
+            for (size_t i = 0; i < positions.size(); i++) {
+                for (const Move& legal : corpus.legalMoves[i]) {
+                    // as the generator hands it over, before willBeCheck is known
+                    const Move move(legal.before, legal.after, legal.promotion, legal.capture, legal.special1, legal.special0);
+                    scratch.clear();
+                    MicroBench::addMoveIfAcceptable(positions[i], scratch, move);
+                    sink += scratch.size();
+                    calls++;
+                }
+            }
+            return calls;
+        }},
+        {"Engine::evaluate", [&](uint64_t& sink) {
+            for (const Board& board : positions) sink += engine.evaluate(board);
+            return (uint64_t) positions.size();
+        }}
+    };
+
+    PerfCounters perf;
+    std::cout << "parakeet-bench: " << positions.size() << " positions, " << runs << " runs";
+    if (perf.available()) std::cout << ", hardware counters on\n";
+    else std::cout << ", hardware counters unavailable (" << perf.error() << ")\n";
+
+    std::cout << std::left << std::setw(28) << "benchmark" << std::right
+              << std::setw(12) << "calls/run" << std::setw(12) << "median ns" << std::setw(10) << "p10 ns"
+              << std::setw(10) << "p90 ns";
+    if (perf.available()) std::cout << std::setw(10) << "cycles" << std::setw(8) << "IPC" << std::setw(10) << "br-miss";
+    std::cout << "\n";
+
+    uint64_t sink = 0;
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) continue;
+
+        const Result result = measure(benchmark, runs, perf, sink);
+        results.push_back(result);
+
+        std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << result.calls << std::setw(12) << result.percentile(0.5)
+                  << std::setw(10) << result.percentile(0.1) << std::setw(10) << result.percentile(0.9);
+        if (result.hasCounters) {
+            const double calls = (double) result.calls * runs;
+            std::cout << std::setw(10) << result.counters.cycles / calls
+                      << std::setw(8) << std::setprecision(2) << (double) result.counters.instructions / std::max<uint64_t>(result.counters.cycles, 1)
+                      << std::setw(10) << std::setprecision(3) << result.counters.branchMisses / calls;
+        }
+        std::cout << std::endl;
+    }
+
+    if (!comparePath.empty()) {
+        const auto before = readMedians(comparePath);
+        if (before.empty()) Log(LogLevel::ERROR, "Nothing to compare in " + comparePath);
+        for (const Result& result : results) {
+            for (const auto& [name, median] : before) {
+                if (name != result.name) continue;
+                const double change = (result.percentile(0.5) / median - 1) * 100;
+                std::cout << "compare " << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+                          << std::setw(10) << median << " -> " << std::setw(10) << result.percentile(0.5) << " ns  "
+                          << std::showpos << change << std::noshowpos << "%\n";
+            }
+        }
+    }
+
+    if (!jsonPath.empty()) writeJson(jsonPath, label, runs, positions.size(), results);
+    return sink == 42 ? 2 : 0;  // sink has to be used somewhere
+}
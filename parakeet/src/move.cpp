@@ -55,4 +55,8 @@ bool Move::isQueenSideCastle() const {
 
 bool Move::isEnPassant() const {
     return (!promotion && capture && special0);
+}
+
+unsigned short Move::encode() const {
+    return before | (after << 6) | (promotion << 15) | (capture << 14) | (special1 << 13) | (special0 << 12);
 }
\ No newline at end of file
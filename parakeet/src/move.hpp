@@ -28,4 +28,7 @@ public:
     bool isQueenSideCastle() const;
     bool isEnPassant() const;
 
+    // 16 bit form: before (6 bits), after (6 bits), then promotion, capture, special1, special0
+    unsigned short encode() const;
+
 };
\ No newline at end of file
@@ -0,0 +1,571 @@
+/* Differential fuzzer for the move generator, built as bin/parakeet-fuzz:
+ *     parakeet-fuzz [games=N] [plies=N] [threads=N] [seed=N] [generators=<name>,...]
+ *
+ * Board::generateAllMoves is the reference. Random games are played from a set of start positions,
+ * and in every position on the way the move set of each registered alternative generator (GENERATORS
+ * below: a new implementation only has to be added there) is compared with the reference's, flags
+ * and willBeCheck included. Every position is also checked against what follows from its pieces
+ * alone: the hash, material, material key, attack maps, check flags, castling rights, the en passant
+ * state and a FEN round trip, so makeMove's incremental updates are covered too. Before any of
+ * that, the hash has to give the keys of the examples in Polyglot's book format.
+ *
+ * A failure is shrunk before it's reported: the game is cut off at the first bad position, started
+ * as late as still fails, and then pieces are taken off the start position one by one for as long
+ * as the same check still fails. The result is a FEN and the moves (UCI) from it. A game only
+ * depends on the seed and its number.
+ */
+#include "board.hpp"
+#include "utility.hpp"
+#include "log.hpp"
+
+#include <mutex>
+#include <cstdio>
+#include <array>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    using Generate = void (*)(const Board& board, std::vector<Move>& moves);
+
+    struct Generator {
+        const char* name;
+        Generate generate;  // every legal move of the side to play, flags and willBeCheck set
+    };
+
+    // Board::generateMoves for every square of the side to play (the GUI's and fromUCI's way in)
+    void generateBySquare(const Board& board, std::vector<Move>& moves) {
+        for (int square = 0; square < 64; square++) {
+            if (board.position[square].side == board.sideToPlay) board.generateMoves(square, moves);
+        }
+    }
+
+    // A generator that shares no code with Board's: pseudo-legal moves from offsets on a plain
+    // position, kept when the king isn't left attacked. Slow, but simple enough to trust.
+    int squareAt(const int file, const int rank) {
+        return (file < 0 || file > 7 || rank < 0 || rank > 7) ? -1 : rank * 8 + file;
+    }
+
+    constexpr int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    constexpr int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+    constexpr int ROOK_LINES[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    constexpr int BISHOP_LINES[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    bool isPiece(const Piece& piece, const PieceType type, const Side side) {
+        return piece.type == type && piece.side == side;
+    }
+
+    bool attackedIn(const std::array<Piece, 64>& position, const int square, const Side by) {
+        const int file = square % 8, rank = square / 8;
+
+        const int pawnRank = rank + ((by == Side::WHITE) ? -1 : 1);
+        for (const int side : {-1, 1}) {
+            const int from = squareAt(file + side, pawnRank);
+            if (from >= 0 && isPiece(position[from], PieceType::PAWN, by)) return true;
+        }
+        for (const auto& step : KNIGHT_STEPS) {
+            const int from = squareAt(file + step[0], rank + step[1]);
+            if (from >= 0 && isPiece(position[from], PieceType::KNIGHT, by)) return true;
+        }
+        for (const auto& step : KING_STEPS) {
+            const int from = squareAt(file + step[0], rank + step[1]);
+            if (from >= 0 && isPiece(position[from], PieceType::KING, by)) return true;
+        }
+
+        const auto slider = [&](const int (&lines)[4][2], const PieceType type) {
+            for (const auto& line : lines) {
+                for (int distance = 1;; distance++) {
+                    const int from = squareAt(file + line[0] * distance, rank + line[1] * distance);
+                    if (from < 0) break;
+                    if (position[from].type == PieceType::EMPTY) continue;
+                    if (position[from].side == by && (position[from].type == type || position[from].type == PieceType::QUEEN)) return true;
+                    break;
+                }
+            }
+            return false;
+        };
+        return slider(ROOK_LINES, PieceType::ROOK) || slider(BISHOP_LINES, PieceType::BISHOP);
+    }
+
+    int findKing(const std::array<Piece, 64>& position, const Side side) {
+        for (int square = 0; square < 64; square++) {
+            if (isPiece(position[square], PieceType::KING, side)) return square;
+        }
+        return -1;
+    }
+
+    void generateNaive(const Board& board, std::vector<Move>& moves) {
+        const Side us = board.sideToPlay, them = opponentOf(us);
+        const std::array<Piece, 64>& position = board.position;
+        const int forward = (us == Side::WHITE) ? 1 : -1;
+
+        // plays the move on a copy of the position, and keeps it if it's legal
+        const auto add = [&](Move move, const PieceType becomes) {
+            std::array<Piece, 64> after = position;
+            after[move.after] = {becomes, us};
+            after[move.before] = EMPTY_SQUARE;
+            if (move.isEnPassant()) after[move.after - 8 * forward] = EMPTY_SQUARE;
+            if (move.isKingSideCastle()) std::swap(after[move.before + 1], after[move.before + 3]);
+            if (move.isQueenSideCastle()) std::swap(after[move.before - 1], after[move.before - 4]);
+
+            if (attackedIn(after, findKing(after, us), them)) return;
+            move.willBeCheck = attackedIn(after, findKing(after, them), us);
+            moves.push_back(move);
+        };
+        const auto addPromotions = [&](const int from, const int to, const bool capture) {
+            add({from, to, true, capture, false, false}, PieceType::KNIGHT);
+            add({from, to, true, capture, false, true}, PieceType::BISHOP);
+            add({from, to, true, capture, true, false}, PieceType::ROOK);
+            add({from, to, true, capture, true, true}, PieceType::QUEEN);
+        };
+        // a quiet move or a capture to to, if it isn't our own piece there. Returns whether the square was empty.
+        const auto step = [&](const int from, const int to, const PieceType type) {
+            if (to < 0 || position[to].side == us) return false;
+            const bool capture = (position[to].type != PieceType::EMPTY);
+            add({from, to, false, capture, false, false}, type);
+            return !capture;
+        };
+
+        for (int square = 0; square < 64; square++) {
+            const Piece piece = position[square];
+            if (piece.side != us) continue;
+            const int file = square % 8, rank = square / 8;
+
+            switch (piece.type) {
+                case PieceType::PAWN: {
+                    const bool promotes = (rank + forward == 0 || rank + forward == 7);
+                    const int ahead = squareAt(file, rank + forward);
+                    if (position[ahead].type == PieceType::EMPTY) {
+                        if (promotes) addPromotions(square, ahead, false);
+                        else add({square, ahead}, PieceType::PAWN);
+
+                        const int twoAhead = squareAt(file, rank + 2 * forward);
+                        if (rank == ((us == Side::WHITE) ? 1 : 6) && position[twoAhead].type == PieceType::EMPTY)
+                            add({square, twoAhead, false, false, false, true}, PieceType::PAWN);
+                    }
+                    for (const int side : {-1, 1}) {
+                        const int to = squareAt(file + side, rank + forward);
+                        if (to < 0) continue;
+                        if (position[to].side == them) {
+                            if (promotes) addPromotions(square, to, true);
+                            else add({square, to, true}, PieceType::PAWN);
+                        }
+                        // en passant: the pawn that has just moved two squares is next to this one
+                        if (board.enPassantPossible && board.lastDoublePawnPush == squareAt(file + side, rank)
+                                && isPiece(position[board.lastDoublePawnPush], PieceType::PAWN, them))
+                            add({square, to, false, true, false, true}, PieceType::PAWN);
+                    }
+                } break;
+
+                case PieceType::KNIGHT:
+                    for (const auto& offset : KNIGHT_STEPS) step(square, squareAt(file + offset[0], rank + offset[1]), piece.type);
+                    break;
+
+                case PieceType::KING: {
+                    for (const auto& offset : KING_STEPS) step(square, squareAt(file + offset[0], rank + offset[1]), piece.type);
+
+                    // castling: through empty squares, out of, through and into squares that aren't attacked
+                    const int home = (us == Side::WHITE) ? 4 : 60;
+                    if (square != home || attackedIn(position, square, them)) break;
+                    const auto empty = [&](const int from, const int to) {
+                        for (int between = from; between <= to; between++) {
+                            if (position[between].type != PieceType::EMPTY) return false;
+                        }
+                        return true;
+                    };
+                    if (board.castlingRightsKingSide.at(us) && isPiece(position[home + 3], PieceType::ROOK, us)
+                            && empty(home + 1, home + 2) && !attackedIn(position, home + 1, them))
+                        add({home, home + 2, false, false, true, false}, PieceType::KING);
+                    if (board.castlingRightsQueenSide.at(us) && isPiece(position[home - 4], PieceType::ROOK, us)
+                            && empty(home - 3, home - 1) && !attackedIn(position, home - 1, them))
+                        add({home, home - 2, false, false, true, true}, PieceType::KING);
+                } break;
+
+                default: {
+                    const bool straight = (piece.type == PieceType::ROOK || piece.type == PieceType::QUEEN);
+                    const bool diagonal = (piece.type == PieceType::BISHOP || piece.type == PieceType::QUEEN);
+                    for (const auto& line : ROOK_LINES) {
+                        for (int distance = 1; straight && step(square, squareAt(file + line[0] * distance, rank + line[1] * distance), piece.type); distance++) {}
+                    }
+                    for (const auto& line : BISHOP_LINES) {
+                        for (int distance = 1; diagonal && step(square, squareAt(file + line[0] * distance, rank + line[1] * distance), piece.type); distance++) {}
+                    }
+                } break;
+            }
+        }
+    }
+
+    // The implementations checked against Board::generateAllMoves. Add new ones here.
+    const std::vector<Generator> GENERATORS = {
+        {"squares", generateBySquare},
+        {"naive", generateNaive},
+    };
+
+    // Where the random games start: the usual perft positions, which between them have every kind of move
+    const std::vector<std::string> START_FENS = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1",
+        "8/8/4k3/8/2pP4/8/6K1/8 b - d3 0 1",
+    };
+
+    // The examples of Polyglot's book format (http://hgm.nubati.net/book_format.html): the moves from
+    // the starting position and the key of the position they lead to. Books only work if Board::hash
+    // gives the same keys.
+    struct KnownKey {
+        const char* moves;
+        uint64_t key;
+    };
+    const std::vector<KnownKey> POLYGLOT_KEYS = {
+        {"", 0x463B96181691FC9C},
+        {"e2e4", 0x823C9B50FD114196},
+        {"e2e4 d7d5", 0x0756B94461C50FB0},
+        {"e2e4 d7d5 e4e5", 0x662FAFB965DB29D4},
+        {"e2e4 d7d5 e4e5 f7f5", 0x22A48B5A8E47FF78},
+        {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652A607CA3F242C1},
+        {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00FDD303C946BDD9},
+        {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3C8123EA7B067637},
+        {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5C3F9B829B279560},
+    };
+
+    // Plays out each of POLYGLOT_KEYS. Returns what's wrong, or an empty string if every key matches.
+    std::string checkPolyglotKeys() {
+        for (const KnownKey& known : POLYGLOT_KEYS) {
+            Board board;
+            loadFEN(START_FENS[0], board);
+            const std::string moves = std::string(known.moves) + " ";
+            for (size_t start = 0, end; (end = moves.find(' ', start)) != std::string::npos; start = end + 1) {
+                if (end == start) continue;
+                Move move;
+                if (!fromUCI(moves.substr(start, end - start), board, move)) return std::string("can't play ") + known.moves;
+                board.makeMove(move);
+            }
+
+            if (board.hash != known.key || board.computeHash() != known.key) {
+                char keys[64];
+                std::snprintf(keys, sizeof(keys), "%016llx, not %016llx",
+                    (unsigned long long) board.hash, (unsigned long long) known.key);
+                return std::string("after \"") + known.moves + "\" the key is " + keys;
+            }
+        }
+        return "";
+    }
+
+    // What went wrong. Shrinking keeps a change only if the same kind of failure comes back.
+    struct Failure {
+        std::string kind;
+        std::string detail;
+        // Whether it's about the position alone (the move sets), and not about how makeMove got
+        // there. Other failures only count after a move, or a FEN that reads in badly would do.
+        bool position = false;
+    };
+
+    std::string describe(const Move& move) {
+        std::string out = uci(move);
+        if (move.capture) out += "(x)";
+        if (move.isEnPassant()) out += "(ep)";
+        if (move.isCastle()) out += "(castle)";
+        if (!move.promotion && !move.capture && !move.special1 && move.special0) out += "(double)";
+        if (move.willBeCheck) out += "(+)";
+        return out;
+    }
+
+    struct Checker {
+        std::vector<const Generator*> generators;
+        // reused between positions
+        std::vector<Move> reference, alternative;
+
+        static std::vector<uint32_t> keys(const std::vector<Move>& moves) {
+            std::vector<uint32_t> out;
+            for (const Move& move : moves) out.push_back(move.encode() | (uint32_t) move.willBeCheck << 16);
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+
+        // The differences between the move sets, as far as they fit on a line
+        static std::string difference(const std::vector<Move>& expected, const std::vector<Move>& got) {
+            const auto missing = [](const std::vector<Move>& from, const std::vector<Move>& in) {
+                std::string out;
+                for (const Move& move : from) {
+                    const bool found = std::any_of(in.begin(), in.end(), [&](const Move& other) {
+                        return other.encode() == move.encode() && other.willBeCheck == move.willBeCheck;
+                    });
+                    if (!found && out.size() < 200) out += " " + describe(move);
+                }
+                return out;
+            };
+            return "missing" + missing(expected, got) + ", extra" + missing(got, expected);
+        }
+
+        // Runs every check on the position. Returns false, with failure filled in, at the first one that fails.
+        bool check(const Board& board, Failure& failure) {
+            const auto fail = [&](const std::string& kind, const std::string& detail, const bool position = false) {
+                failure = {kind, detail, position};
+                return false;
+            };
+
+            if (board.hash != board.computeHash()) return fail("hash", "incremental hash differs from computeHash");
+            if (board.materialDifference != board.computeMaterialDifference())
+                return fail("material", std::to_string(board.materialDifference) + " instead of " + std::to_string(board.computeMaterialDifference()));
+            if (board.materialKey != board.computeMaterialKey()) return fail("material key", "incremental key differs from computeMaterialKey");
+
+            const AttackMaps maps = board.computeAttackMaps();
+            for (int side = 0; side < 2; side++) {
+                for (int square = 0; square < 64; square++) {
+                    if (board.attackMaps.counts[side][square] == maps.counts[side][square]) continue;
+                    return fail("attack maps", std::string(side ? "black" : "white") + " attacks on square " + std::to_string(square)
+                        + ": " + std::to_string(board.attackMaps.counts[side][square]) + " instead of " + std::to_string(maps.counts[side][square]));
+                }
+            }
+
+            for (const Side side : {Side::WHITE, Side::BLACK}) {
+                const int king = findKing(board.position, side);
+                if (king < 0 || board.kingSquare(side) != king) return fail("king", "king square out of date");
+                if (board.check.at(side) != attackedIn(board.position, king, opponentOf(side)))
+                    return fail("check flags", std::string(side == Side::WHITE ? "white" : "black") + " check flag is wrong");
+
+                const int home = (side == Side::WHITE) ? 4 : 60;
+                const bool kingHome = isPiece(board.position[home], PieceType::KING, side);
+                if (board.castlingRightsKingSide.at(side) && !(kingHome && isPiece(board.position[home + 3], PieceType::ROOK, side)))
+                    return fail("castling rights", "king side right kept without the king and rook at home");
+                if (board.castlingRightsQueenSide.at(side) && !(kingHome && isPiece(board.position[home - 4], PieceType::ROOK, side)))
+                    return fail("castling rights", "queen side right kept without the king and rook at home");
+            }
+            if (attackedIn(board.position, findKing(board.position, opponentOf(board.sideToPlay)), board.sideToPlay))
+                return fail("legality", "the side that just moved is in check");
+
+            if (board.enPassantPossible) {
+                const int pawn = board.lastDoublePawnPush;
+                const int rank = (board.sideToPlay == Side::WHITE) ? 4 : 3;
+                if (pawn >= 64 || pawn / 8 != rank || !isPiece(board.position[pawn], PieceType::PAWN, opponentOf(board.sideToPlay)))
+                    return fail("en passant", "en passant allowed without a pawn that just moved two squares");
+            }
+
+            reference.clear();
+            board.generateAllMoves(reference);
+            const std::vector<uint32_t> expected = keys(reference);
+
+            for (const Generator* generator : generators) {
+                alternative.clear();
+                generator->generate(board, alternative);
+                if (keys(alternative) != expected) return fail(std::string(generator->name) + " moves", difference(reference, alternative), true);
+            }
+
+            // the same position from scratch
+            const std::string fen = getFEN(board);
+            Board fresh;
+            const char* error = nullptr;
+            if (!loadFEN(fen, fresh, &error)) return fail("fen round trip", std::string("can't read back ") + fen + ": " + error);
+            if (fresh.hash != board.hash) return fail("fen round trip", "hash differs after reading back " + fen);
+            alternative.clear();
+            fresh.generateAllMoves(alternative);
+            if (keys(alternative) != expected) return fail("fen round trip", "moves differ after reading back " + fen + ": " + difference(reference, alternative));
+
+            return true;
+        }
+    };
+
+    // Plays the moves from the FEN, checking every position. Returns whether a check failed the
+    // way expected did, and false if the FEN or a move is no good.
+    bool fails(Checker& checker, const std::string& fen, const std::vector<std::string>& moves,
+               const Failure& expected, Failure& failure) {
+        Board board;
+        if (!loadFEN(fen, board)) return false;
+        if (!checker.check(board, failure)) return failure.kind == expected.kind && expected.position;
+
+        for (const std::string& text : moves) {
+            Move move;
+            if (!fromUCI(text, board, move)) return false;
+            board.makeMove(move);
+            if (!checker.check(board, failure)) return failure.kind == expected.kind;
+        }
+        return false;
+    }
+
+    struct Game {
+        uint64_t number = 0;
+        std::string fen;
+        std::vector<std::string> moves;
+        Failure failure;
+    };
+
+    // Cuts a failing game down: started as late as possible, with as few pieces as possible
+    void shrink(Checker& checker, Game& game) {
+        const Failure expected = game.failure;
+        Failure failure;
+
+        // a later start: the position i moves in, as a FEN, and the rest of the moves
+        Board board;
+        loadFEN(game.fen, board);
+        std::vector<std::string> fens = {game.fen};
+        for (const std::string& text : game.moves) {
+            Move move;
+            fromUCI(text, board, move);
+            board.makeMove(move);
+            fens.push_back(getFEN(board));
+        }
+        for (size_t start = game.moves.size(); start > 0; start--) {
+            const std::vector<std::string> rest(game.moves.begin() + start, game.moves.end());
+            if (fails(checker, fens[start], rest, expected, failure)) {
+                game.fen = fens[start];
+                game.moves = rest;
+                break;
+            }
+        }
+
+        // fewer pieces: take one off as long as the same check still fails
+        for (bool shrunk = true; shrunk;) {
+            shrunk = false;
+            loadFEN(game.fen, board);
+
+            for (int square = 0; square < 64 && !shrunk; square++) {
+                const PieceType type = board.position[square].type;
+                if (type == PieceType::EMPTY || type == PieceType::KING) continue;
+
+                std::array<Piece, 64> position = board.position;
+                position[square] = EMPTY_SQUARE;
+                // rights to castle with a rook that's gone go with it
+                const auto right = [&](const Side side, const bool kingSide) {
+                    const int rook = ((side == Side::WHITE) ? 4 : 60) + (kingSide ? 3 : -4);
+                    const auto& rights = kingSide ? board.castlingRightsKingSide : board.castlingRightsQueenSide;
+                    return rights.at(side) && rook != square;
+                };
+                const bool enPassant = board.enPassantPossible && board.lastDoublePawnPush != square;
+
+                Board smaller;
+                smaller.setUp(position, board.sideToPlay,
+                    right(Side::WHITE, true), right(Side::WHITE, false), right(Side::BLACK, true), right(Side::BLACK, false),
+                    enPassant, enPassant ? board.lastDoublePawnPush : 64, board.halfmoveClock, board.fullmoveNumber);
+                // the side that isn't to play can't be in check
+                if (smaller.check.at(opponentOf(smaller.sideToPlay))) continue;
+
+                const std::string fen = getFEN(smaller);
+                if (fails(checker, fen, game.moves, expected, failure)) {
+                    game.fen = fen;
+                    shrunk = true;
+                }
+            }
+        }
+
+        fails(checker, game.fen, game.moves, expected, game.failure);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t games = 10000;
+    int plies = 200;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = 1;
+    std::vector<const Generator*> generators;
+    for (const Generator& generator : GENERATORS) generators.push_back(&generator);
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg.rfind("games=", 0) == 0) games = std::stoull(arg.substr(6));
+            else if (arg.rfind("plies=", 0) == 0) plies = std::max(0, std::stoi(arg.substr(6)));
+            else if (arg.rfind("threads=", 0) == 0) threads = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("seed=", 0) == 0) seed = std::stoull(arg.substr(5));
+            else if (arg.rfind("generators=", 0) == 0) {
+                generators.clear();
+                const std::string names = arg.substr(11) + ",";
+                for (size_t start = 0, end; (end = names.find(',', start)) != std::string::npos; start = end + 1) {
+                    const std::string name = names.substr(start, end - start);
+                    if (name.empty() || name == "none") continue;
+
+                    const auto found = std::find_if(GENERATORS.begin(), GENERATORS.end(),
+                        [&](const Generator& generator) { return name == generator.name; });
+                    if (found == GENERATORS.end()) throw std::invalid_argument(name);
+                    generators.push_back(&*found);
+                }
+            }
+            else throw std::invalid_argument(arg);
+        } catch (const std::exception&) {
+            std::string names;
+            for (const Generator& generator : GENERATORS) names += std::string(names.empty() ? "" : ",") + generator.name;
+            Log(LogLevel::ERROR, "Bad argument " + arg);
+            Log(LogLevel::ERROR, "Usage: parakeet-fuzz [games=N] [plies=N] [threads=N] [seed=N] [generators=<name>,...] (generators: " + names + ", or none)");
+            return 1;
+        }
+    }
+
+    const std::string keyFailure = checkPolyglotKeys();
+    if (!keyFailure.empty()) {
+        std::cout << "$fuzz polyglot keys failed: " << keyFailure << std::endl;
+        return 1;
+    }
+
+    std::atomic<uint64_t> nextGame{0};
+    std::atomic<bool> failed{false};
+    std::atomic<uint64_t> positions{0};
+    std::mutex failureMutex;
+    Game first;     // the failing game with the lowest number, so the report doesn't depend on the threads
+
+    const auto worker = [&]() {
+        Checker checker;
+        checker.generators = generators;
+        std::vector<Move> moves;
+        uint64_t checked = 0;
+
+        for (uint64_t number = nextGame++; number < games && !failed; number = nextGame++) {
+            std::seed_seq sequence{seed, number};
+            std::mt19937 rng(sequence);
+
+            Game game;
+            game.number = number;
+            game.fen = START_FENS[number % START_FENS.size()];
+            Board board;
+            loadFEN(game.fen, board);
+
+            for (int ply = 0;; ply++) {
+                checked++;
+                if (!checker.check(board, game.failure)) {
+                    std::lock_guard<std::mutex> lock(failureMutex);
+                    if (!failed || number < first.number) first = game;
+                    failed = true;
+                    break;
+                }
+                if (ply == plies) break;
+
+                moves.clear();
+                board.generateAllMoves(moves);
+                if (moves.empty()) break;
+
+                const Move move = moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)];
+                game.moves.push_back(uci(move));
+                board.makeMove(move);
+            }
+        }
+        positions += checked;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; i++) workers.emplace_back(worker);
+    for (std::thread& thread : workers) thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "$fuzz games " << std::min<uint64_t>(nextGame, games) << " positions " << positions
+              << " time " << (int) (seconds * 1000) << " ms positions/s " << (uint64_t) (positions / std::max(seconds, 0.001)) << std::endl;
+    if (!failed) return 0;
+
+    std::cout << "$fuzz game " << first.number << " failed: " << first.failure.kind << ": " << first.failure.detail << std::endl;
+    Checker checker;
+    checker.generators = generators;
+    shrink(checker, first);
+
+    std::string moves;
+    for (const std::string& move : first.moves) moves += " " + move;
+    std::cout << "$fuzz shrunk: " << first.failure.kind << ": " << first.failure.detail << "\n"
+              << "$fuzz fen " << first.fen << " moves" << moves << std::endl;
+    return 1;
+}
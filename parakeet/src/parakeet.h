@@ -0,0 +1,76 @@
+#ifndef PARAKEET_H
+#define PARAKEET_H
+
+/* C interface to the engine, for using it in-process (e.g. from Python through ctypes).
+ *
+ * Every parakeet_engine is independent, so different engines can be used from different threads
+ * at the same time. A single engine must only be used by one thread at a time.
+ * Moves are in UCI notation: e2e4, e7e8q, and castling as the king's move (e1g1).
+ * Functions that can fail return PARAKEET_OK or one of the negative error codes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(PARAKEET_SHARED)
+    #define PARAKEET_API __declspec(dllexport)
+#else
+    #define PARAKEET_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    PARAKEET_OK = 0,
+    PARAKEET_ERROR_ARGUMENT = -1,       /* null pointer or out of range value */
+    PARAKEET_ERROR_FEN = -2,            /* the FEN couldn't be read */
+    PARAKEET_ERROR_MOVE = -3,           /* a move isn't legal in the position it's played in */
+    PARAKEET_ERROR_BUFFER = -4,         /* the output buffer is too small */
+    PARAKEET_ERROR_INTERNAL = -5
+};
+
+typedef struct parakeet_engine parakeet_engine;
+
+typedef struct {
+    int depth;          /* in plies, 0 for the engine's default */
+    uint64_t nodes;     /* 0 for no limit */
+} parakeet_limits;
+
+typedef struct {
+    char best_move[8];  /* empty if there is no legal move */
+    int score;          /* centipawns from the side to move's point of view */
+    int depth;          /* depth of the last completed iteration */
+    uint64_t nodes;
+    double time_ms;
+} parakeet_result;
+
+PARAKEET_API parakeet_engine* parakeet_new(void);
+PARAKEET_API void parakeet_free(parakeet_engine* engine);
+
+/* Forgets the transposition table and history, like a new game */
+PARAKEET_API int parakeet_new_game(parakeet_engine* engine);
+
+/* fen may be NULL for the starting position. moves is a space separated list played from there (or NULL). */
+PARAKEET_API int parakeet_set_position(parakeet_engine* engine, const char* fen, const char* moves);
+
+/* Searches the current position without playing a move. limits may be NULL for the defaults. */
+PARAKEET_API int parakeet_search(parakeet_engine* engine, const parakeet_limits* limits, parakeet_result* result);
+
+/* Writes the legal moves, space separated and null terminated, to buffer.
+ * Returns the number of moves. */
+PARAKEET_API int parakeet_legal_moves(parakeet_engine* engine, char* buffer, size_t size);
+
+/* Writes the current position as a null terminated FEN to buffer (90 bytes is always enough).
+ * Returns its length. */
+PARAKEET_API int parakeet_get_fen(parakeet_engine* engine, char* buffer, size_t size);
+
+/* Number of leaf nodes of the move tree of the given depth, or a negative error code */
+PARAKEET_API int64_t parakeet_perft(parakeet_engine* engine, int depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
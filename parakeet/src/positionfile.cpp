@@ -0,0 +1,211 @@
+#include "positionfile.hpp"
+#include "log.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef PARAKEET_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t COMPRESSED = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t records;
+        uint64_t blocks;
+        uint32_t recordSize;
+        uint32_t flags;
+        uint32_t blockRecords;
+        char reserved[28];
+    };
+    static_assert(sizeof(Header) == 64, "position file header should be 64 bytes");
+
+    struct BlockHeader {
+        uint32_t records;
+        uint32_t bytes;     // compressed size of the block that follows
+    };
+}
+
+PositionWriter::PositionWriter(const std::string& path, const bool compress)
+    : m_out(path, std::ios::binary | std::ios::trunc), m_compress(compress)
+{
+#ifndef PARAKEET_ZLIB
+    if (m_compress) {
+        Log(LogLevel::WARN, "This build has no zlib (PARAKEET_ZLIB), writing " + path + " uncompressed");
+        m_compress = false;
+    }
+#endif
+    if (!m_out.is_open()) {
+        Log(LogLevel::WARN, "Couldn't open " + path + " for writing");
+        return;
+    }
+
+    // a placeholder until close() knows the counts
+    const Header header = {};
+    m_out.write((const char*) &header, sizeof(Header));
+    m_block.reserve(POSITION_FILE_BLOCK_RECORDS);
+    m_open = true;
+}
+
+PositionWriter::~PositionWriter() {
+    close();
+}
+
+void PositionWriter::write(const PackedPosition& position) {
+    if (!m_open) return;
+    m_block.push_back(position);
+    if (m_block.size() == POSITION_FILE_BLOCK_RECORDS) writeBlock();
+}
+
+bool PositionWriter::writeBlock() {
+    if (m_block.empty()) return true;
+
+    const size_t bytes = m_block.size() * sizeof(PackedPosition);
+    if (!m_compress) {
+        m_out.write((const char*) m_block.data(), bytes);
+    } else {
+#ifdef PARAKEET_ZLIB
+        std::vector<unsigned char> compressed(compressBound(bytes));
+        uLongf compressedBytes = compressed.size();
+        if (compress2(compressed.data(), &compressedBytes, (const Bytef*) m_block.data(), bytes, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            m_failed = true;
+        } else {
+            const BlockHeader block = {(uint32_t) m_block.size(), (uint32_t) compressedBytes};
+            m_out.write((const char*) &block, sizeof(BlockHeader));
+            m_out.write((const char*) compressed.data(), compressedBytes);
+        }
+#endif
+    }
+
+    m_records += m_block.size();
+    m_blocks++;
+    m_block.clear();
+    if (!m_out.good()) m_failed = true;
+    return !m_failed;
+}
+
+bool PositionWriter::close() {
+    if (!m_open) return false;
+    m_open = false;
+
+    writeBlock();
+
+    Header header = {};
+    std::memcpy(header.magic, "PKPF", 4);
+    header.version = VERSION;
+    header.records = m_records;
+    header.blocks = m_blocks;
+    header.recordSize = sizeof(PackedPosition);
+    header.flags = m_compress ? COMPRESSED : 0;
+    header.blockRecords = POSITION_FILE_BLOCK_RECORDS;
+
+    m_out.seekp(0);
+    m_out.write((const char*) &header, sizeof(Header));
+    m_out.close();
+
+    if (m_out.fail() || m_failed) {
+        Log(LogLevel::WARN, "Couldn't write position file");
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<PositionReader> PositionReader::open(const std::string& path) {
+    auto file = std::make_unique<MappedFile>(path);
+    if (!file->isOpen() || file->size() < sizeof(Header)) {
+        Log(LogLevel::WARN, "Couldn't open position file " + path);
+        return nullptr;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+
+    if (std::memcmp(header.magic, "PKPF", 4) != 0 || header.version != VERSION
+            || header.recordSize != sizeof(PackedPosition) || header.blockRecords == 0) {
+        Log(LogLevel::WARN, path + " isn't a position file this build reads");
+        return nullptr;
+    }
+
+    const bool compressed = header.flags & COMPRESSED;
+#ifndef PARAKEET_ZLIB
+    if (compressed) {
+        Log(LogLevel::WARN, path + " is compressed, which needs a build with zlib (PARAKEET_ZLIB)");
+        return nullptr;
+    }
+#endif
+    if (!compressed && file->size() != sizeof(Header) + header.records * sizeof(PackedPosition)) {
+        Log(LogLevel::WARN, "Position file " + path + " has the wrong size");
+        return nullptr;
+    }
+
+    std::unique_ptr<PositionReader> reader(new PositionReader());
+    reader->m_file = std::move(file);
+    reader->m_compressed = compressed;
+    reader->m_records = header.records;
+    reader->rewind();
+    return reader;
+}
+
+void PositionReader::rewind() {
+    m_offset = sizeof(Header);
+    m_recordsRead = 0;
+    m_current = nullptr;
+    m_currentSize = 0;
+    m_currentIndex = 0;
+}
+
+size_t PositionReader::nextBlock(const PackedPosition*& records) {
+    records = nullptr;
+    if (m_recordsRead >= m_records) return 0;
+
+    if (!m_compressed) {
+        const size_t count = std::min<uint64_t>(m_records - m_recordsRead, POSITION_FILE_BLOCK_RECORDS);
+        records = (const PackedPosition*) (m_file->data() + m_offset);
+        m_offset += count * sizeof(PackedPosition);
+        m_recordsRead += count;
+        return count;
+    }
+
+#ifdef PARAKEET_ZLIB
+    BlockHeader block;
+    if (m_offset + sizeof(BlockHeader) > m_file->size()) return 0;
+    std::memcpy(&block, m_file->data() + m_offset, sizeof(BlockHeader));
+    m_offset += sizeof(BlockHeader);
+
+    if (block.records == 0 || m_recordsRead + block.records > m_records || m_offset + block.bytes > m_file->size()) {
+        Log(LogLevel::WARN, "Position file is damaged (bad block)");
+        m_recordsRead = m_records;
+        return 0;
+    }
+
+    m_buffer.resize(block.records);
+    uLongf bytes = block.records * sizeof(PackedPosition);
+    if (uncompress((Bytef*) m_buffer.data(), &bytes, m_file->data() + m_offset, block.bytes) != Z_OK
+            || bytes != block.records * sizeof(PackedPosition)) {
+        Log(LogLevel::WARN, "Position file is damaged (block doesn't decompress)");
+        m_recordsRead = m_records;
+        return 0;
+    }
+
+    m_offset += block.bytes;
+    m_recordsRead += block.records;
+    records = m_buffer.data();
+    return block.records;
+#else
+    return 0;
+#endif
+}
+
+bool PositionReader::next(PackedPosition& position) {
+    if (m_currentIndex == m_currentSize) {
+        m_currentSize = nextBlock(m_current);
+        m_currentIndex = 0;
+        if (m_currentSize == 0) return false;
+    }
+    position = m_current[m_currentIndex++];
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#include "mappedfile.hpp"
+#include "types/packedposition.hpp"
+
+/* Files of PackedPositions, for datasets (e.g. from selfplay) and regression suites.
+ *
+ * A 64 byte header is followed either by the records back to back, so that a memory-mapped file
+ * can be iterated in place, or, for a compressed file, by blocks of up to BLOCK_RECORDS records,
+ * each deflated with zlib and preceded by its record count and compressed size.
+ * Compression needs a build with PARAKEET_ZLIB defined (linked with -lz).
+ */
+constexpr uint32_t POSITION_FILE_BLOCK_RECORDS = 4096;
+
+class PositionWriter {
+public:
+    // compress is ignored (with a warning) in builds without zlib
+    PositionWriter(const std::string& path, const bool compress = false);
+    ~PositionWriter();
+
+    PositionWriter(const PositionWriter&) = delete;
+    PositionWriter& operator=(const PositionWriter&) = delete;
+
+    bool isOpen() const { return m_open; }
+    void write(const PackedPosition& position);
+
+    // Writes the remaining records and the final header. Returns false if anything couldn't be written.
+    bool close();
+
+    uint64_t size() const { return m_records + m_block.size(); }
+
+private:
+    bool writeBlock();
+
+    std::ofstream m_out;
+    bool m_open = false;
+    bool m_compress = false;
+    bool m_failed = false;
+
+    std::vector<PackedPosition> m_block;
+    uint64_t m_records = 0;
+    uint64_t m_blocks = 0;
+};
+
+class PositionReader {
+public:
+    // Returns nullptr if the file is missing or isn't a position file this build can read
+    static std::unique_ptr<PositionReader> open(const std::string& path);
+
+    uint64_t size() const { return m_records; }
+    bool compressed() const { return m_compressed; }
+
+    // Points records at the next block and returns how many it has, 0 at the end of the file.
+    // For an uncompressed file the records are read in place from the mapping.
+    size_t nextBlock(const PackedPosition*& records);
+    // One record at a time, built on nextBlock
+    bool next(PackedPosition& position);
+
+    void rewind();
+
+private:
+    PositionReader() = default;
+
+    std::unique_ptr<MappedFile> m_file;
+    bool m_compressed = false;
+    uint64_t m_records = 0;
+
+    size_t m_offset = 0;        // of the next block in the file
+    uint64_t m_recordsRead = 0;
+
+    std::vector<PackedPosition> m_buffer;   // decompressed block
+    const PackedPosition* m_current = nullptr;
+    size_t m_currentSize = 0;
+    size_t m_currentIndex = 0;
+};
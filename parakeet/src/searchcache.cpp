@@ -0,0 +1,150 @@
+#include "searchcache.hpp"
+#include "zobrist.hpp"
+#include "log.hpp"
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// compile.bat sets this to the time of the build, for every file. Other builds fall back to when
+// this file was compiled.
+#ifndef PARAKEET_BUILD_ID
+#define PARAKEET_BUILD_ID __DATE__ " " __TIME__
+#endif
+
+namespace {
+    constexpr uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t buildId;
+        uint64_t entries;
+        uint64_t checksum;
+        uint32_t entrySize;
+        char reserved[28];
+    };
+    static_assert(sizeof(Header) == 64, "search cache header should be 64 bytes");
+    static_assert(sizeof(TTEntry) == 16, "search cache entries are written as they are in memory");
+
+    // FNV-1a (see http://www.isthe.com/chongo/tech/comp/fnv/)
+    uint64_t fnv1a(const unsigned char* data, const size_t length, uint64_t hash = 0xcbf29ce484222325) {
+        for (size_t i = 0; i < length; i++) {
+            hash ^= data[i];
+            hash *= 0x100000001b3;
+        }
+        return hash;
+    }
+
+    uint64_t buildId(const uint64_t evaluation) {
+        const char* id = PARAKEET_BUILD_ID;
+        uint64_t hash = fnv1a((const unsigned char*) id, std::strlen(id));
+        hash = fnv1a((const unsigned char*) &zobrist::keys[0], sizeof(uint64_t), hash);
+        hash = fnv1a((const unsigned char*) &evaluation, sizeof(evaluation), hash);
+        return hash;
+    }
+}
+
+std::unique_ptr<SearchCache> SearchCache::open(const std::string& path, const uint64_t evaluation) {
+    auto file = std::make_unique<MappedFile>(path);
+    if (!file->isOpen() || file->size() < sizeof(Header)) {
+        Log(LogLevel::WARN, "Couldn't open search cache " + path);
+        return nullptr;
+    }
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+
+    if (std::memcmp(header.magic, "PKSC", 4) != 0 || header.version != VERSION || header.entrySize != sizeof(TTEntry)) {
+        Log(LogLevel::WARN, "Search cache " + path + " isn't in a format this build reads");
+        return nullptr;
+    }
+    if (header.buildId != buildId(evaluation)) {
+        Log(LogLevel::WARN, "Search cache " + path + " was made by a different build or with a different evaluation, ignoring it");
+        return nullptr;
+    }
+    if (header.entries == 0 || (header.entries & (header.entries - 1)) != 0
+            || file->size() != sizeof(Header) + header.entries * sizeof(TTEntry)) {
+        Log(LogLevel::WARN, "Search cache " + path + " has the wrong size");
+        return nullptr;
+    }
+
+    const unsigned char* entries = file->data() + sizeof(Header);
+    if (fnv1a(entries, header.entries * sizeof(TTEntry)) != header.checksum) {
+        Log(LogLevel::WARN, "Search cache " + path + " is damaged (checksum mismatch)");
+        return nullptr;
+    }
+
+    std::unique_ptr<SearchCache> cache(new SearchCache());
+    cache->m_path = path;
+    cache->m_file = std::move(file);
+    cache->m_entries = (const TTEntry*) entries;
+    cache->m_mask = header.entries - 1;
+    return cache;
+}
+
+bool SearchCache::save(const std::string& path, const TranspositionTable& table, const uint64_t evaluation,
+        std::unique_ptr<SearchCache>& cache) {
+    const SearchCache* previous = cache.get();
+    std::vector<TTEntry> entries = table.entries();
+    const uint64_t mask = entries.size() - 1;
+
+    if (previous != nullptr) {
+        for (size_t i = 0; i < previous->size(); i++) {
+            const TTEntry& old = previous->m_entries[i];
+            if (old.bound == Bound::NONE) continue;
+
+            TTEntry& slot = entries[old.key & mask];
+            if (slot.bound == Bound::NONE || (slot.key == old.key && slot.depth < old.depth)) slot = old;
+        }
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, "PKSC", 4);
+    header.version = VERSION;
+    header.buildId = buildId(evaluation);
+    header.entries = entries.size();
+    header.checksum = fnv1a((const unsigned char*) entries.data(), entries.size() * sizeof(TTEntry));
+    header.entrySize = sizeof(TTEntry);
+
+    // written to a temporary file first, so a snapshot that's mapped somewhere isn't changed under it
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write((const char*) &header, sizeof(Header));
+        out.write((const char*) entries.data(), entries.size() * sizeof(TTEntry));
+        if (!out.good()) {
+            Log(LogLevel::WARN, "Couldn't write search cache " + path);
+            return false;
+        }
+    }
+    // Windows won't replace a mapped file, so the snapshot in use lets go of its file first
+    const std::string previousPath = previous ? previous->m_path : "";
+    cache.reset();
+
+    // std::rename doesn't replace an existing file on Windows
+#ifdef _WIN32
+    const bool replaced = MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool replaced = std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+    if (!replaced) {
+        std::remove(temporary.c_str());
+        Log(LogLevel::WARN, "Couldn't write search cache " + path);
+    }
+
+    // the new snapshot has everything the old one had that the table didn't replace
+    if (!previousPath.empty()) cache = open(replaced ? path : previousPath, evaluation);
+    return replaced;
+}
+
+const TTEntry* SearchCache::probe(const uint64_t key) const {
+    const TTEntry& entry = m_entries[key & m_mask];
+    if (entry.bound != Bound::NONE && entry.key == key) return &entry;
+    return nullptr;
+}
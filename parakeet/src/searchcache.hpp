@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "mappedfile.hpp"
+#include "transpositiontable.hpp"
+
+/* A snapshot of the transposition table on disk, memory-mapped read-only and probed in place.
+ *
+ * The file is a 64 byte header followed by the entries, laid out like the table they were taken
+ * from (a power of two of them, indexed by key). The header holds a version, an id of the build
+ * and evaluation that wrote it and a checksum of the entries. Snapshots from other builds, or made
+ * with other piece values or evaluation terms, are rejected, because their evals needn't mean the
+ * same thing.
+ */
+class SearchCache {
+public:
+    // evaluation identifies what the evals depend on besides the build (Engine::evaluationId).
+    // Returns nullptr if the file is missing, damaged or was written by a different build or evaluation.
+    static std::unique_ptr<SearchCache> open(const std::string& path, const uint64_t evaluation);
+
+    // Writes the table's entries as a snapshot. Entries of the snapshot in use (cache, if there is one)
+    // are kept where they don't collide with a deeper result from the table. Windows can't replace a
+    // file that's mapped, and cache may be mapping the very file being replaced, so it's closed while
+    // the file is replaced and then reopened: on the new snapshot if it was written, or else on its own.
+    static bool save(const std::string& path, const TranspositionTable& table, const uint64_t evaluation,
+        std::unique_ptr<SearchCache>& cache);
+
+    const TTEntry* probe(const uint64_t key) const;
+    size_t size() const { return m_mask + 1; }
+
+private:
+    SearchCache() = default;
+
+    std::string m_path;
+    std::unique_ptr<MappedFile> m_file;
+    const TTEntry* m_entries = nullptr;
+    uint64_t m_mask = 0;
+};
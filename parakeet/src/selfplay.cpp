@@ -0,0 +1,195 @@
+#include "selfplay.hpp"
+#include "engine.hpp"
+#include "book.hpp"
+#include "endgame.hpp"
+#include "positionfile.hpp"
+#include "log.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+
+namespace selfplay {
+namespace {
+    struct Settings {
+        uint64_t games = 100;
+        SearchLimits limits;
+        int randomPlies = 8;
+        uint64_t seed = 1;
+        std::shared_ptr<const OpeningBook> book;
+    };
+
+    struct ThreadStats {
+        uint64_t games = 0;
+        uint64_t positions = 0;
+        uint64_t nodes = 0;
+        double seconds = 0;
+    };
+
+    // games that go on longer than this are called drawn
+    constexpr int MAX_PLIES = 400;
+    // scores are stored in 16 bits, and anything this big is a won or lost position anyway
+    constexpr int MAX_SCORE = 32000;
+
+    // Sets up the book and random moves a game starts with. Returns false if they end the game.
+    bool playOpening(Engine& engine, const Settings& settings, std::mt19937& rng, std::vector<uint64_t>& hashes) {
+        engine.board.reset();
+        hashes = {engine.board.hash};
+
+        Move bookMove;
+        while (settings.book && settings.book->probe(engine.board, bookMove, false, rng)) {
+            engine.board.makeMove(bookMove);
+            hashes.push_back(engine.board.hash);
+        }
+
+        std::vector<Move> moves;
+        for (int ply = 0; ply <= settings.randomPlies; ply++) {
+            moves.clear();
+            engine.board.generateAllMoves(moves);
+            if (moves.empty()) return false;
+            if (ply == settings.randomPlies) break;     // only checking the game isn't over
+
+            engine.board.makeMove(moves[std::uniform_int_distribution<size_t>(0, moves.size() - 1)(rng)]);
+            hashes.push_back(engine.board.hash);
+        }
+        return true;
+    }
+
+    // Plays one game, adding its searched positions to records. Returns the result for white (1, 0 or -1).
+    int8_t playGame(Engine& engine, const Settings& settings, const uint64_t number,
+                    std::vector<PackedPosition>& records, uint64_t& nodes) {
+        std::seed_seq seed{settings.seed, number};
+        std::mt19937 rng(seed);
+
+        engine.newGame();
+
+        // an opening that ends the game (a random mate) is replaced by the next one from the same sequence
+        std::vector<uint64_t> hashes;
+        for (int tries = 0; !playOpening(engine, settings, rng, hashes); tries++) {
+            if (tries == 100) return 0;
+        }
+
+        std::vector<Move> moves;
+        for (int ply = 0; ply < MAX_PLIES; ply++) {
+            const Board& board = engine.board;
+
+            moves.clear();
+            board.generateAllMoves(moves);
+            if (moves.empty()) {
+                if (!board.check.at(board.sideToPlay)) return 0;
+                return (board.sideToPlay == Side::WHITE) ? -1 : 1;
+            }
+            if (board.halfmoveClock >= 100 || endgame::insufficientMaterial(board)) return 0;
+            if (std::count(hashes.begin(), hashes.end(), board.hash) >= 3) return 0;
+
+            const SearchResult result = engine.analyse(settings.limits);
+            nodes += result.nodes;
+
+            PackedPosition packed = board.pack();
+            packed.score = (int16_t) std::clamp(result.eval, -MAX_SCORE, MAX_SCORE);
+            records.push_back(packed);
+
+            engine.board.makeMove(result.bestMove);
+            hashes.push_back(engine.board.hash);
+        }
+        return 0;
+    }
+}
+
+int run(int argc, char* argv[]) {
+    std::string path;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool compress = false;
+    Settings settings;
+
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg.rfind("games=", 0) == 0) settings.games = std::stoull(arg.substr(6));
+            else if (arg.rfind("threads=", 0) == 0) threads = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("depth=", 0) == 0) settings.limits.depth = std::stoi(arg.substr(6));
+            else if (arg.rfind("nodes=", 0) == 0) settings.limits.nodes = std::stoull(arg.substr(6));
+            else if (arg.rfind("random=", 0) == 0) settings.randomPlies = std::max(0, std::stoi(arg.substr(7)));
+            else if (arg.rfind("seed=", 0) == 0) settings.seed = std::stoull(arg.substr(5));
+            else if (arg.rfind("book=", 0) == 0) {
+                settings.book = OpeningBook::open(arg.substr(5));
+                if (!settings.book) {
+                    Log(LogLevel::ERROR, "Couldn't open book " + arg.substr(5));
+                    return 1;
+                }
+            }
+            else if (arg == "compress") compress = true;
+            else path = arg;
+        } catch (const std::exception&) {
+            Log(LogLevel::ERROR, "Bad selfplay argument " + arg);
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        Log(LogLevel::ERROR, "Usage: parakeet selfplay <out> [games=N] [threads=N] [depth=N] [nodes=N] [random=N] [book=<file>] [seed=N] [compress]");
+        return 1;
+    }
+    if (settings.limits.depth == 0 && settings.limits.nodes == 0) settings.limits.depth = 4;
+
+    PositionWriter writer(path, compress);
+    if (!writer.isOpen()) return 1;
+
+    std::vector<std::unique_ptr<Engine>> engines;
+    for (unsigned int i = 0; i < threads; i++) engines.push_back(std::make_unique<Engine>());
+
+    std::atomic<uint64_t> nextGame{0};
+    std::mutex writerMutex;
+    uint64_t results[3] = {0, 0, 0};   // black wins, draws, white wins
+    std::vector<ThreadStats> stats(threads);
+
+    const auto worker = [&](Engine& engine, ThreadStats& threadStats) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<PackedPosition> records;
+
+        for (uint64_t number = nextGame++; number < settings.games; number = nextGame++) {
+            records.clear();
+            const int8_t result = playGame(engine, settings, number, records, threadStats.nodes);
+
+            for (PackedPosition& record : records) record.result = result;
+            threadStats.games++;
+            threadStats.positions += records.size();
+
+            // whole games at a time, so a game's positions stay together in the file
+            std::lock_guard<std::mutex> lock(writerMutex);
+            for (const PackedPosition& record : records) writer.write(record);
+            results[result + 1]++;
+        }
+        threadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; i++) workers.emplace_back(worker, std::ref(*engines[i]), std::ref(stats[i]));
+    for (std::thread& thread : workers) thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!writer.close()) return 1;
+
+    uint64_t games = 0, positions = 0, nodes = 0;
+    for (unsigned int i = 0; i < threads; i++) {
+        const ThreadStats& thread = stats[i];
+        std::cout << "$selfplay thread " << i << " games " << thread.games << " positions " << thread.positions
+                  << " positions/s " << (uint64_t) (thread.positions / std::max(thread.seconds, 0.001))
+                  << " nps " << (uint64_t) (thread.nodes / std::max(thread.seconds, 0.001)) << "\n";
+        games += thread.games;
+        positions += thread.positions;
+        nodes += thread.nodes;
+    }
+    std::cout << "$selfplay games " << games << " positions " << positions
+              << " white " << results[2] << " draws " << results[1] << " black " << results[0]
+              << " time " << (int) (seconds * 1000) << " ms positions/s " << (uint64_t) (positions / std::max(seconds, 0.001))
+              << " nps " << (uint64_t) (nodes / std::max(seconds, 0.001)) << std::endl;
+    return 0;
+}
+}
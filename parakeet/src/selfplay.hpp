@@ -0,0 +1,15 @@
+#pragma once
+
+/* Self-play data generation:
+ *     parakeet selfplay <out> [games=N] [threads=N] [depth=N] [nodes=N] [random=N] [book=<file>] [seed=N] [compress]
+ *
+ * Plays games of the engine against itself on a pool of worker threads, each with its own Engine,
+ * and writes every searched position to a position file (positionfile.hpp) with the search's score
+ * and the game's result. Games start from the book (if one is given) followed by random plies, and
+ * every move after that is searched with the same depth or node limit. A game's openings and moves
+ * only depend on the seed and its number, not on which thread played it.
+ */
+namespace selfplay {
+    // argv without the program name and "selfplay". Returns the exit code.
+    int run(int argc, char* argv[]);
+}
@@ -0,0 +1,447 @@
+#include "server.hpp"
+#include "log.hpp"
+
+#ifdef _WIN32
+
+namespace server {
+int run(int, char*[]) {
+    Log(LogLevel::ERROR, "parakeet serve needs Unix domain sockets, which this build doesn't have");
+    return 1;
+}
+}
+
+#else
+
+#include "engine.hpp"
+#include "book.hpp"
+#include "utility.hpp"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+namespace server {
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings {
+        std::string path;
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+        int moveTime = 1000;    // ms for a search without limits
+        int maxTime = 10000;    // ms any search may take at most
+        std::shared_ptr<const OpeningBook> book;
+    };
+
+    // longer request lines get the connection closed
+    constexpr size_t MAX_LINE = 4096;
+    // a client that doesn't take its replies for this long is disconnected
+    constexpr int SEND_TIMEOUT_SECONDS = 5;
+    // how often the I/O thread looks for a signal to stop
+    constexpr int POLL_MS = 200;
+
+    volatile std::sig_atomic_t stopRequested = 0;
+    void onSignal(int) { stopRequested = 1; }
+
+    struct Session;
+
+    class Connection {
+    public:
+        explicit Connection(const int fd) : m_fd(fd) {}
+        ~Connection() { close(m_fd); }
+
+        int fd() const { return m_fd; }
+        bool isOpen() const { return m_open; }
+        void hangUp() {
+            m_open = false;
+            shutdown(m_fd, SHUT_RDWR);
+        }
+
+        // Sends a line, from any thread. Clients that have gone away are hung up on.
+        void send(const std::string& line) {
+            const std::string out = line + "\n";
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t sent = 0; sent < out.size() && m_open;) {
+                const ssize_t count = ::send(m_fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (count < 0 && errno == EINTR) continue;
+                if (count <= 0) hangUp();
+                else sent += count;
+            }
+        }
+
+        // Only used by the I/O thread
+        std::string input;  // the part of a line received so far
+        std::unordered_map<std::string, std::shared_ptr<Session>> sessions;
+
+    private:
+        const int m_fd;
+        std::mutex m_mutex;     // one line at a time
+        std::atomic<bool> m_open{true};
+    };
+
+    struct Request {
+        std::vector<std::string> words;     // the command, the session id and the arguments
+        Clock::time_point received;
+    };
+
+    struct Session {
+        std::string id;
+        std::shared_ptr<Connection> connection;
+        Board board;    // only touched by the thread serving the session's request
+
+        // the scheduler's
+        std::deque<Request> requests;
+        bool scheduled = false;     // in the ready queue, or a request of it is being served
+    };
+
+    // Hands out requests round robin over the sessions that have some waiting, one per turn, and
+    // never two of the same session at once
+    class Scheduler {
+    public:
+        void submit(const std::shared_ptr<Session>& session, Request&& request) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            session->requests.push_back(std::move(request));
+            if (session->scheduled) return;
+
+            session->scheduled = true;
+            m_ready.push_back(session);
+            m_wake.notify_one();
+        }
+
+        // Waits for the next request to serve. Returns false once stopped.
+        bool next(std::shared_ptr<Session>& session, Request& request) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stopped || !m_ready.empty(); });
+            if (m_stopped) return false;
+
+            session = std::move(m_ready.front());
+            m_ready.pop_front();
+            request = std::move(session->requests.front());
+            session->requests.pop_front();
+            return true;
+        }
+
+        // After serving a request from next(): the session waits for its next turn, if it has more
+        void done(const std::shared_ptr<Session>& session) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (session->requests.empty()) {
+                session->scheduled = false;
+                return;
+            }
+            m_ready.push_back(session);
+            m_wake.notify_one();
+        }
+
+        void stop() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopped = true;
+            m_wake.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<std::shared_ptr<Session>> m_ready;
+        bool m_stopped = false;
+    };
+
+    struct WorkerStats {
+        uint64_t requests = 0;
+        uint64_t searches = 0;
+        uint64_t nodes = 0;
+    };
+
+    std::vector<std::string> split(const std::string& line) {
+        std::istringstream stream(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (stream >> word) words.push_back(word);
+        return words;
+    }
+
+    // Reads "depth N nodes N time ms" into limits, and applies the server's time limits
+    bool readLimits(const std::vector<std::string>& words, const Settings& settings, SearchLimits& limits) {
+        for (size_t i = 2; i < words.size(); i += 2) {
+            if (i + 1 == words.size()) return false;
+            try {
+                if (words[i] == "depth") limits.depth = std::clamp(std::stoi(words[i+1]), 1, 64);
+                else if (words[i] == "nodes") limits.nodes = std::max(std::stoull(words[i+1]), 1ull);
+                else if (words[i] == "time") limits.time = std::max(std::stoi(words[i+1]), 1);
+                else return false;
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+
+        if (limits.time == 0) limits.time = (limits.depth || limits.nodes) ? settings.maxTime : settings.moveTime;
+        limits.time = std::min(limits.time, settings.maxTime);
+        return true;
+    }
+
+    void serve(Engine& engine, Session& session, const Request& request, const Settings& settings,
+               std::mt19937& rng, WorkerStats& stats) {
+        Connection& connection = *session.connection;
+        if (!connection.isOpen()) return;   // nobody to answer
+
+        const std::vector<std::string>& words = request.words;
+        const std::string& command = words[0];
+        const std::string& id = session.id;
+        const auto error = [&](const std::string& message) { connection.send("error " + id + " " + message); };
+
+        if (command == "new") {
+            std::string fen;
+            for (size_t i = 2; i < words.size(); i++) fen += (i > 2 ? " " : "") + words[i];
+
+            if (fen.empty()) {
+                session.board.reset();
+            } else {
+                const char* why = nullptr;
+                if (!loadFEN(fen, session.board, &why)) return error(std::string("bad fen: ") + (why ? why : "invalid"));
+            }
+            connection.send("ok " + id);
+        } else if (command == "move") {
+            Board board = session.board;    // all of the moves or none of them
+            for (size_t i = 2; i < words.size(); i++) {
+                Move move;
+                if (!fromUCI(words[i], board, move)) return error("illegal move " + words[i]);
+                board.makeMove(move);
+            }
+            session.board = board;
+            connection.send("ok " + id);
+        } else if (command == "fen") {
+            connection.send("fen " + id + " " + getFEN(session.board));
+        } else if (command == "close") {
+            connection.send("closed " + id);
+        } else if (command == "go") {
+            SearchLimits limits;
+            if (!readLimits(words, settings, limits)) return error("bad limits, expected [depth N] [nodes N] [time ms]");
+
+            Move bookMove;
+            if (settings.book && settings.book->probe(session.board, bookMove, false, rng)) {
+                connection.send("bestmove " + id + " " + uci(bookMove) + " book");
+                return;
+            }
+
+            std::vector<Move> moves;
+            session.board.generateAllMoves(moves);
+            if (moves.empty()) {
+                connection.send("bestmove " + id + " none");
+                return;
+            }
+
+            // the time the request spent waiting counts
+            const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - request.received).count();
+            limits.time = (int) std::max<int64_t>(limits.time - waited, 1);
+
+            const auto start = Clock::now();
+            engine.board = session.board;
+            const SearchResult result = engine.analyse(limits);
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+            stats.searches++;
+            stats.nodes += result.nodes;
+
+            connection.send("bestmove " + id + " " + uci(result.bestMove) + " score " + std::to_string(result.eval)
+                + " depth " + std::to_string(result.depth) + " nodes " + std::to_string(result.nodes) + " time " + std::to_string(ms));
+        }
+    }
+
+    // Runs on the I/O thread: answers what needs no session state, and queues the rest
+    void handle(const std::shared_ptr<Connection>& connection, const std::string& line, Scheduler& scheduler) {
+        std::vector<std::string> words = split(line);
+        if (words.empty()) return;
+
+        const std::string& command = words[0];
+        if (command == "ping") return connection->send("pong");
+        if (command == "quit") return connection->hangUp();
+
+        if (command != "new" && command != "move" && command != "go" && command != "fen" && command != "close")
+            return connection->send("error " + (words.size() > 1 ? words[1] : "-") + " unknown command " + command);
+        if (words.size() < 2) return connection->send("error - " + command + " needs a session id");
+
+        const std::string id = words[1];
+        auto found = connection->sessions.find(id);
+        if (found == connection->sessions.end()) {
+            if (command != "new") return connection->send("error " + id + " no such session");
+
+            auto session = std::make_shared<Session>();
+            session->id = id;
+            session->connection = connection;
+            found = connection->sessions.emplace(id, std::move(session)).first;
+        }
+
+        const std::shared_ptr<Session> session = found->second;
+        if (command == "close") connection->sessions.erase(found);
+        scheduler.submit(session, {std::move(words), Clock::now()});
+    }
+
+    // Reads what the client has sent and handles every complete line. Returns false when it's gone.
+    bool receive(const std::shared_ptr<Connection>& connection, Scheduler& scheduler) {
+        char buffer[4096];
+        const ssize_t count = recv(connection->fd(), buffer, sizeof(buffer), 0);
+        if (count < 0 && errno == EINTR) return true;
+        if (count <= 0) return false;
+
+        connection->input.append(buffer, count);
+        size_t start = 0;
+        for (size_t end; (end = connection->input.find('\n', start)) != std::string::npos; start = end + 1) {
+            std::string line = connection->input.substr(start, end - start);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            handle(connection, line, scheduler);
+            if (!connection->isOpen()) return false;
+        }
+        connection->input.erase(0, start);
+        return connection->input.size() <= MAX_LINE;
+    }
+
+    int listenOn(const std::string& path) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            Log(LogLevel::ERROR, "Socket path too long: " + path);
+            return -1;
+        }
+        std::strcpy(address.sun_path, path.c_str());
+
+        // a socket left behind by an earlier server is replaced, anything else is left alone
+        struct stat existing;
+        if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(path.c_str());
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, (const sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            Log(LogLevel::ERROR, "Couldn't listen on " + path + ": " + std::strerror(errno));
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+int run(int argc, char* argv[]) {
+    Settings settings;
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg.rfind("threads=", 0) == 0) settings.threads = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("movetime=", 0) == 0) settings.moveTime = std::max(1, std::stoi(arg.substr(9)));
+            else if (arg.rfind("maxtime=", 0) == 0) settings.maxTime = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("book=", 0) == 0) {
+                settings.book = OpeningBook::open(arg.substr(5));
+                if (!settings.book) {
+                    Log(LogLevel::ERROR, "Couldn't open book " + arg.substr(5));
+                    return 1;
+                }
+            }
+            else settings.path = arg;
+        } catch (const std::exception&) {
+            Log(LogLevel::ERROR, "Bad serve argument " + arg);
+            return 1;
+        }
+    }
+    if (settings.path.empty()) {
+        Log(LogLevel::ERROR, "Usage: parakeet serve <socket> [threads=N] [movetime=ms] [maxtime=ms] [book=<file>]");
+        return 1;
+    }
+    settings.moveTime = std::min(settings.moveTime, settings.maxTime);
+
+    const int listener = listenOn(settings.path);
+    if (listener < 0) return 1;
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Scheduler scheduler;
+    std::vector<std::unique_ptr<Engine>> engines;
+    for (unsigned int i = 0; i < settings.threads; i++) engines.push_back(std::make_unique<Engine>());
+    std::vector<WorkerStats> stats(settings.threads);
+
+    const auto worker = [&](Engine& engine, WorkerStats& threadStats, const unsigned int number) {
+        std::mt19937 rng(number);   // for weighted book moves
+        std::shared_ptr<Session> session;
+        Request request;
+        while (scheduler.next(session, request)) {
+            serve(engine, *session, request, settings, rng, threadStats);
+            threadStats.requests++;
+            scheduler.done(session);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < settings.threads; i++) workers.emplace_back(worker, std::ref(*engines[i]), std::ref(stats[i]), i);
+
+    std::cout << "$serve listening on " << settings.path << " threads " << settings.threads << std::endl;
+
+    const timeval sendTimeout = {SEND_TIMEOUT_SECONDS, 0};
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+    uint64_t accepted = 0;
+    while (!stopRequested) {
+        fds.assign(1, {listener, POLLIN, 0});
+        for (const auto& connection : connections) fds.push_back({connection->fd(), POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), POLL_MS) < 0) {
+            if (errno == EINTR) continue;
+            Log(LogLevel::ERROR, std::string("poll failed: ") + std::strerror(errno));
+            break;
+        }
+
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents == 0) continue;
+            if (!receive(connections[i-1], scheduler)) connections[i-1]->hangUp();
+        }
+
+        // the sessions of a closed connection go with it once their requests are done with
+        for (const auto& connection : connections) {
+            if (!connection->isOpen()) connection->sessions.clear();
+        }
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+            [](const std::shared_ptr<Connection>& connection) { return !connection->isOpen(); }), connections.end());
+
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                connections.push_back(std::make_shared<Connection>(fd));
+                accepted++;
+            }
+        }
+    }
+
+    close(listener);
+    unlink(settings.path.c_str());
+    scheduler.stop();
+    for (std::thread& thread : workers) thread.join();
+    for (const auto& connection : connections) {
+        connection->hangUp();
+        connection->sessions.clear();
+    }
+
+    WorkerStats total;
+    for (const WorkerStats& thread : stats) {
+        total.requests += thread.requests;
+        total.searches += thread.searches;
+        total.nodes += thread.nodes;
+    }
+    std::cout << "$serve connections " << accepted << " requests " << total.requests << " searches " << total.searches
+              << " nodes " << total.nodes << std::endl;
+    return 0;
+}
+}
+
+#endif
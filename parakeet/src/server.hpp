@@ -0,0 +1,31 @@
+#pragma once
+
+/* Engine server on a Unix domain socket:
+ *     parakeet serve <socket> [threads=N] [movetime=ms] [maxtime=ms] [book=<file>]
+ *
+ * Serves any number of games over any number of connections with a fixed pool of search threads,
+ * each with its own Engine (and transposition table). Games are sessions: a connection names them
+ * itself and they keep their own board. Tablebases, the attack tables and the book are shared by
+ * all of them.
+ *
+ * The protocol is a line per request and a line per reply. Requests for a session are carried out
+ * in order, one at a time; sessions with requests waiting take turns, one request each, so a busy
+ * session can't hold up the others.
+ *     new <id> [fen]       start a game, from the starting position or the FEN   -> ok <id>
+ *     move <id> <uci>...   play moves                                             -> ok <id>
+ *     go <id> [depth N] [nodes N] [time ms]
+ *                          search (or look up the book) and reply with the best move, without
+ *                          playing it -> bestmove <id> <uci> score E depth D nodes N time T
+ *                          (bestmove <id> <uci> book, or bestmove <id> none if the game is over)
+ *     fen <id>             -> fen <id> <fen>
+ *     close <id>           forget the session                                     -> closed <id>
+ *     ping                 -> pong
+ *     quit                 close the connection
+ * Errors are reported as error <id> <message>. A search's time counts from when its request
+ * arrived, so time spent waiting for a thread is part of it; it's movetime if the request gives
+ * no limit, and never more than maxtime.
+ */
+namespace server {
+    // argv without the program name and "serve". Returns the exit code.
+    int run(int argc, char* argv[]);
+}
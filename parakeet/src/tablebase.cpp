@@ -0,0 +1,677 @@
+#include "tablebase.hpp"
+#include "log.hpp"
+#include "attacks.hpp"
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+namespace tablebase {
+
+namespace {
+    constexpr uint8_t UNKNOWN = 254;    // only used during generation
+    constexpr int MAX_DISTANCE = 252;   // so that distance + 1 stays below UNKNOWN
+    constexpr const char* PIECE_ORDER = "QRBNP";    // strongest first
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        char material[8];
+        uint64_t size;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(Header) == 32, "tablebase header should be 32 bytes");
+
+    constexpr uint32_t VERSION = 1;
+
+    constexpr std::array<int, 10> TRIANGLE = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+
+    std::string path = "tablebases";
+    std::mutex registryMutex;
+    std::map<std::string, std::shared_ptr<Table>> registry;
+
+    // The loaded tables of the registry by material key, so that probe neither locks nor allocates.
+    // A key with up to MAX_PIECES - 2 pieces besides the kings gets the digits in base 17 of its
+    // pieces' nibbles, numbered from 1. A material and its mirror image share a table.
+    static_assert(MAX_PIECES == 4, "SLOTS has room for two pieces besides the kings");
+    constexpr size_t SLOTS = 17 * 17;
+    std::array<std::atomic<const Table*>, SLOTS> loadedTables;
+
+    size_t slot(uint64_t key) {
+        size_t out = 0;
+        while (key != 0) {
+            const int nibble = __builtin_ctzll(key) / 4;
+            out = out * 17 + nibble + 1;
+            key -= uint64_t(1) << (nibble * 4);
+        }
+        return out;
+    }
+
+    void addLoaded(const Table& table) {
+        loadedTables[slot(table.materialKey())].store(&table, std::memory_order_release);
+        loadedTables[slot(material::mirror(table.materialKey()))].store(&table, std::memory_order_release);
+    }
+
+    PieceType typeFromLetter(const char c) {
+        switch (c) {
+            case 'K': return PieceType::KING;
+            case 'Q': return PieceType::QUEEN;
+            case 'R': return PieceType::ROOK;
+            case 'B': return PieceType::BISHOP;
+            case 'N': return PieceType::KNIGHT;
+            case 'P': return PieceType::PAWN;
+        }
+        return PieceType::EMPTY;
+    }
+
+    // splits "KRKP" into "R" and "P". Returns false if it isn't a valid material string.
+    bool splitMaterial(const std::string& material, std::string& white, std::string& black) {
+        if (material.size() < 2 || material[0] != 'K') return false;
+        const size_t blackKing = material.find('K', 1);
+        if (blackKing == std::string::npos) return false;
+
+        white = material.substr(1, blackKing-1);
+        black = material.substr(blackKing+1);
+
+        for (const char c : white + black) {
+            if (c == '\0' || std::strchr(PIECE_ORDER, c) == nullptr) return false;
+        }
+        return true;
+    }
+
+    int strength(const char c) {
+        return std::strchr(PIECE_ORDER, c) - PIECE_ORDER;   // 0 is strongest
+    }
+
+    void sortByStrength(std::string& pieces) {
+        std::sort(pieces.begin(), pieces.end(), [](const char a, const char b) {
+            return strength(a) < strength(b);
+        });
+    }
+
+    // true if white's pieces are at least as strong as black's
+    bool strongerOrEqual(const std::string& white, const std::string& black) {
+        if (white.size() != black.size()) return white.size() > black.size();
+        for (size_t i = 0; i < white.size(); i++) {
+            if (white[i] != black[i]) return strength(white[i]) < strength(black[i]);
+        }
+        return true;
+    }
+
+    std::shared_ptr<Table> getTable(const std::string& material) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        std::shared_ptr<Table>& table = registry[material];
+        if (!table) {
+            table = std::make_shared<Table>(material);
+            if (table->load(path + "/" + material + ".ptb")) addLoaded(*table);
+        }
+        return table;
+    }
+
+    // Every material of up to MAX_PIECES, so that probe finds whatever tables are in the directory
+    void loadAll() {
+        std::vector<std::string> sides = {""};
+        for (const char* a = PIECE_ORDER; *a != '\0'; a++) {
+            sides.push_back(std::string(1, *a));
+            for (const char* b = PIECE_ORDER; *b != '\0'; b++) sides.push_back(std::string{*a, *b});
+        }
+
+        for (const std::string& white : sides) {
+            for (const std::string& black : sides) {
+                const std::string material = canonicalMaterial("K" + white + "K" + black);
+                if (!material.empty()) getTable(material);
+            }
+        }
+    }
+
+    // Materials a table can convert into by a capture and/or promotion
+    std::vector<std::string> childMaterials(const std::string& material) {
+        std::string white, black;
+        splitMaterial(material, white, black);
+
+        std::vector<std::string> out;
+        const auto add = [&](const std::string& w, const std::string& b) {
+            const std::string child = canonicalMaterial("K" + w + "K" + b);
+            if (child != material && std::find(out.begin(), out.end(), child) == out.end())
+                out.push_back(child);
+        };
+
+        for (int side = 0; side < 2; side++) {
+            const std::string& own = (side == 0) ? white : black;
+            const std::string& other = (side == 0) ? black : white;
+            const auto addForSide = [&](const std::string& newOwn, const std::string& newOther) {
+                if (side == 0) add(newOwn, newOther);
+                else add(newOther, newOwn);
+            };
+
+            for (size_t i = 0; i < other.size(); i++) {
+                addForSide(own, other.substr(0, i) + other.substr(i+1));   // capture
+            }
+
+            for (size_t i = 0; i < own.size(); i++) {
+                if (own[i] != 'P') continue;
+                for (const char promotion : std::string("QRBN")) {
+                    std::string promoted = own;
+                    promoted[i] = promotion;
+                    addForSide(promoted, other);
+                    for (size_t j = 0; j < other.size(); j++) {
+                        addForSide(promoted, other.substr(0, j) + other.substr(j+1));   // capture and promote
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+    constexpr int distanceOf(const uint8_t value) { return value - 1; }
+    constexpr bool isWin(const uint8_t value) { return value != DRAW && value < UNKNOWN && distanceOf(value) % 2 == 1; }
+
+    // the squares the white king can be on in the index, after mirroring
+    bool canonicalKingSquare(const int square, const bool pawnless) {
+        if (square % 8 > 3) return false;
+        if (pawnless && (square / 8 > 3 || square / 8 > square % 8)) return false;
+        return true;
+    }
+
+    // What the first pass finds out about a position that isn't decided straight away
+    struct Unresolved {
+        uint8_t movesLeft = 0;          // moves within the table that haven't been shown to lose
+        uint8_t longestExitWin = 0;     // longest distance (+1) of a capture or promotion that wins for the opponent
+        int shortestExitLoss = -1;      // shortest distance of a capture or promotion that loses for the opponent
+        bool exitDraw = false;
+    };
+
+    // First pass: uses the board's move generator to find illegal positions, mates and stalemates,
+    // count each position's moves that stay in the table and look up the ones that leave it.
+    uint8_t firstPass(const Table& table, const size_t index, Unresolved& out) {
+        std::array<int, MAX_PIECES> squares;
+        Side sideToPlay;
+        if (!table.decode(index, squares, sideToPlay)) return ILLEGAL;
+
+        std::array<Piece, 64> position;
+        table.position(index, position, sideToPlay);
+        for (int square = 0; square < 64; square++) {
+            if (position[square].type == PieceType::PAWN && (square < 8 || square >= 56)) return ILLEGAL;
+        }
+
+        const Side opponent = (sideToPlay == Side::WHITE) ? Side::BLACK : Side::WHITE;
+        Board board;
+        board.setUp(position, sideToPlay, false, false, false, false, false, 64);
+        if (board.check.at(opponent)) return ILLEGAL;
+
+        std::vector<Move> moves;
+        board.generateAllMoves(moves);
+
+        if (moves.size() == 0) {
+            if (board.check.at(sideToPlay)) return 1;   // checkmated: loss in 0 plies
+            return DRAW;
+        }
+
+        for (const Move& move : moves) {
+            if (!move.capture && !move.promotion) {
+                out.movesLeft++;
+                continue;
+            }
+
+            Board newBoard = board;
+            newBoard.makeMove(move);
+            uint8_t child;
+            if (!probe(newBoard, child)) {
+                out.exitDraw = true;    // shouldn't happen, the smaller tables are made first
+                continue;
+            }
+
+            if (child == DRAW) out.exitDraw = true;
+            else if (isWin(child)) out.longestExitWin = std::max<int>(out.longestExitWin, distanceOf(child) + 1);
+            else if (out.shortestExitLoss == -1 || distanceOf(child) < out.shortestExitLoss) out.shortestExitLoss = distanceOf(child);
+        }
+        return UNKNOWN;
+    }
+
+    // Calls f(squares) for every position from which the side that isn't to play could have
+    // moved into this one without capturing or promoting
+    template<typename F>
+    void forEachUnmove(const Table& table, const std::array<int, MAX_PIECES>& squares, const Side sideToPlay, F f) {
+        const std::vector<Piece>& pieces = table.pieces();
+        std::array<bool, 64> occupied = {};
+        for (size_t i = 0; i < pieces.size(); i++) occupied[squares[i]] = true;
+
+        const auto tryStep = [&](std::array<int, MAX_PIECES>& from, const size_t i, const int x, const int y) {
+            if (x < 0 || x > 7 || y < 0 || y > 7 || occupied[y*8 + x]) return false;
+            from[i] = y*8 + x;
+            f(from);
+            return true;
+        };
+
+        static const int knight[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+        static const int king[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+        for (size_t i = 0; i < pieces.size(); i++) {
+            if (pieces[i].side == sideToPlay) continue;
+
+            std::array<int, MAX_PIECES> from = squares;
+            const int x = squares[i] % 8, y = squares[i] / 8;
+
+            switch (pieces[i].type) {
+                case PieceType::KING:
+                    for (const auto& d : king) tryStep(from, i, x + d[0], y + d[1]);
+                    break;
+                case PieceType::KNIGHT:
+                    for (const auto& d : knight) tryStep(from, i, x + d[0], y + d[1]);
+                    break;
+                case PieceType::QUEEN:
+                case PieceType::ROOK:
+                case PieceType::BISHOP:
+                    for (int d = 0; d < 8; d++) {
+                        const bool diagonal = (d % 2 == 1);
+                        if (pieces[i].type == PieceType::ROOK && diagonal) continue;
+                        if (pieces[i].type == PieceType::BISHOP && !diagonal) continue;
+                        for (int step = 1; tryStep(from, i, x + king[d][0]*step, y + king[d][1]*step); step++);
+                    }
+                    break;
+                case PieceType::PAWN: {
+                    const int back = (pieces[i].side == Side::WHITE) ? -1 : 1;
+                    const int thirdRank = (pieces[i].side == Side::WHITE) ? 3 : 4;  // where double pushes land
+                    if (y + back >= 1 && y + back <= 6 && tryStep(from, i, x, y + back) && y == thirdRank)
+                        tryStep(from, i, x, y + 2*back);
+                } break;
+                case PieceType::EMPTY:
+                    break;
+            }
+        }
+    }
+}
+
+//==========================================================================
+// Table
+Table::Table(const std::string& material) : m_material(material), m_materialKey(material::key(material)) {
+    std::string white, black;
+    splitMaterial(material, white, black);
+
+    m_pieces.push_back({PieceType::KING, Side::WHITE});
+    m_pieces.push_back({PieceType::KING, Side::BLACK});
+    for (const char c : white) m_pieces.push_back({typeFromLetter(c), Side::WHITE});
+    for (const char c : black) m_pieces.push_back({typeFromLetter(c), Side::BLACK});
+
+    m_pawnless = (white + black).find('P') == std::string::npos;
+    m_kingSquares = m_pawnless ? 10 : 32;
+
+    m_size = 2 * m_kingSquares;
+    for (size_t i = 1; i < m_pieces.size(); i++) m_size *= 64;
+}
+
+size_t Table::index(std::array<int, MAX_PIECES> squares, const Side sideToPlay) const {
+    const size_t n = m_pieces.size();
+    const auto transform = [&](int (*f)(int)) {
+        for (size_t i = 0; i < n; i++) squares[i] = f(squares[i]);
+    };
+
+    if (squares[0] % 8 > 3) transform([](int sq) { return sq ^ 7; });     // mirror files
+    if (m_pawnless) {
+        if (squares[0] / 8 > 3) transform([](int sq) { return sq ^ 56; });  // mirror ranks
+        if (squares[0] / 8 > squares[0] % 8) transform([](int sq) { return (sq % 8) * 8 + sq / 8; });   // mirror along a1-h8
+    }
+
+    size_t kingIndex;
+    if (m_pawnless) kingIndex = std::find(TRIANGLE.begin(), TRIANGLE.end(), squares[0]) - TRIANGLE.begin();
+    else kingIndex = (squares[0] / 8) * 4 + squares[0] % 8;
+
+    size_t out = (sideToPlay == Side::WHITE ? 0 : 1) * m_kingSquares + kingIndex;
+    for (size_t i = 1; i < n; i++) out = out * 64 + squares[i];
+    return out;
+}
+
+bool Table::decode(size_t index, std::array<int, MAX_PIECES>& squares, Side& sideToPlay) const {
+    for (size_t i = m_pieces.size()-1; i > 0; i--) {
+        squares[i] = index % 64;
+        index /= 64;
+    }
+    const size_t kingIndex = index % m_kingSquares;
+    sideToPlay = (index / m_kingSquares == 0) ? Side::WHITE : Side::BLACK;
+    squares[0] = m_pawnless ? TRIANGLE[kingIndex] : (int) ((kingIndex / 4) * 8 + kingIndex % 4);
+
+    for (size_t i = 0; i < m_pieces.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (squares[i] == squares[j]) return false;
+        }
+    }
+    return true;
+}
+
+bool Table::position(const size_t index, std::array<Piece, 64>& position, Side& sideToPlay) const {
+    const size_t n = m_pieces.size();
+    std::array<int, MAX_PIECES> squares;
+    decode(index, squares, sideToPlay);
+
+    position.fill(EMPTY_SQUARE);
+    for (size_t i = 0; i < n; i++) {
+        if (position[squares[i]].type != PieceType::EMPTY) return false;
+        position[squares[i]] = m_pieces[i];
+    }
+    return true;
+}
+
+bool Table::load(const std::string& path) {
+    auto file = std::make_unique<MappedFile>(path);
+    if (!file->isOpen() || file->size() < sizeof(Header) + m_size) return false;
+
+    Header header;
+    std::memcpy(&header, file->data(), sizeof(Header));
+    if (std::memcmp(header.magic, "PKTB", 4) != 0 || header.version != VERSION || header.size != m_size
+            || std::string(header.material, strnlen(header.material, 8)) != m_material) {
+        Log(LogLevel::WARN, "Ignoring tablebase " + path + " (wrong format or version)");
+        return false;
+    }
+
+    m_file = std::move(file);
+    m_values = m_file->data() + sizeof(Header);
+    return true;
+}
+
+bool Table::save(const std::string& path) const {
+    if (!loaded()) return false;
+
+    Header header = {};
+    std::memcpy(header.magic, "PKTB", 4);
+    header.version = VERSION;
+    std::memcpy(header.material, m_material.data(), std::min(m_material.size(), sizeof(header.material)));
+    header.size = m_size;
+
+    std::ofstream out(path, std::ios::binary);
+    out.write((const char*) &header, sizeof(Header));
+    out.write((const char*) m_values, m_size);
+    return out.good();
+}
+
+void Table::setValues(std::vector<uint8_t>&& values) {
+    m_generated = std::move(values);
+    m_file = nullptr;
+    m_values = m_generated.data();
+}
+
+//==========================================================================
+// Free functions
+void setPath(const std::string& newPath) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        path = newPath;
+        for (std::atomic<const Table*>& table : loadedTables) table.store(nullptr, std::memory_order_relaxed);
+        registry.clear();
+    }
+    loadAll();
+}
+
+const std::string& getPath() {
+    return path;
+}
+
+std::string canonicalMaterial(const std::string& material) {
+    std::string white, black;
+    if (!splitMaterial(material, white, black)) return "";
+    if (white.size() + black.size() + 2 > MAX_PIECES) return "";
+
+    sortByStrength(white);
+    sortByStrength(black);
+    if (!strongerOrEqual(white, black)) std::swap(white, black);
+
+    return "K" + white + "K" + black;
+}
+
+int countPieces(const Board& board) {
+    return __builtin_popcountll(board.occupancy());
+}
+
+bool probe(const Board& board, uint8_t& value) {
+    // the tables in the default directory, the first time anything probes
+    static const bool initialized = (loadAll(), true);
+    (void) initialized;
+
+    if (countPieces(board) > MAX_PIECES) return false;
+    const Table* table = loadedTables[slot(board.materialKey)].load(std::memory_order_acquire);
+    if (table == nullptr) return false;
+    const bool flipped = (board.materialKey != table->materialKey());
+
+    struct Placed {
+        Piece piece;
+        int square;
+    };
+    std::array<Placed, MAX_PIECES> placed;
+    int count = 0;
+    for (uint64_t occupied = board.occupancy(); occupied != 0;) {
+        const int square = attacks::popSquare(occupied);
+        placed[count++] = {board.position[square], square};
+    }
+
+    // with the colours swapped the board is also turned around, so pawns still move the right way
+    Side sideToPlay = board.sideToPlay;
+    if (flipped) {
+        for (int i = 0; i < count; i++) {
+            placed[i].piece.side = (placed[i].piece.side == Side::WHITE) ? Side::BLACK : Side::WHITE;
+            placed[i].square ^= 56;
+        }
+        sideToPlay = (sideToPlay == Side::WHITE) ? Side::BLACK : Side::WHITE;
+    }
+
+    std::array<int, MAX_PIECES> squares;
+    std::array<bool, MAX_PIECES> used = {};
+    const std::vector<Piece>& pieces = table->pieces();
+    for (size_t i = 0; i < pieces.size(); i++) {
+        for (int j = 0; j < count; j++) {
+            if (!used[j] && placed[j].piece.type == pieces[i].type && placed[j].piece.side == pieces[i].side) {
+                squares[i] = placed[j].square;
+                used[j] = true;
+                break;
+            }
+        }
+    }
+
+    value = table->value(table->index(squares, sideToPlay));
+    return value != ILLEGAL;
+}
+
+bool generate(const std::string& requested, GenerationStats& stats) {
+    const std::string material = canonicalMaterial(requested);
+    if (material.empty()) {
+        Log(LogLevel::WARN, "Can't make a tablebase for " + requested);
+        return false;
+    }
+
+    for (const std::string& child : childMaterials(material)) {
+        if (getTable(child)->loaded()) continue;
+
+        GenerationStats childStats;
+        if (!generate(child, childStats)) return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::shared_ptr<Table> table = getTable(material);
+    const size_t size = table->size();
+
+    std::vector<uint8_t> values(size, UNKNOWN);
+    std::vector<uint8_t> movesLeft(size, 0);
+    std::vector<uint8_t> longestExitWin(size, 0);
+
+    // positions waiting to be decided, by distance to mate
+    std::vector<std::vector<uint32_t>> queue(MAX_DISTANCE + 1);
+
+    // The first pass runs on every core, each thread on its own part of the table
+    {
+        const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<std::vector<uint32_t>>> threadQueues(threadCount, std::vector<std::vector<uint32_t>>(MAX_DISTANCE + 1));
+        std::vector<std::thread> threads;
+
+        for (size_t t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t]() {
+                const size_t begin = size * t / threadCount;
+                const size_t end = size * (t+1) / threadCount;
+
+                for (size_t index = begin; index < end; index++) {
+                    Unresolved info;
+                    values[index] = firstPass(*table, index, info);
+
+                    if (values[index] == 1) {   // checkmate
+                        values[index] = UNKNOWN;
+                        threadQueues[t][0].push_back(index);
+                    }
+                    if (values[index] != UNKNOWN) continue;
+
+                    // a capture or promotion that draws or wins means we can never be forced into a loss
+                    const bool escape = info.exitDraw || info.shortestExitLoss != -1;
+                    movesLeft[index] = info.movesLeft + (escape ? 1 : 0);
+                    longestExitWin[index] = info.longestExitWin;
+
+                    if (info.shortestExitLoss != -1 && info.shortestExitLoss + 1 <= MAX_DISTANCE)
+                        threadQueues[t][info.shortestExitLoss + 1].push_back(index);
+                    else if (movesLeft[index] == 0 && info.longestExitWin <= MAX_DISTANCE)
+                        threadQueues[t][info.longestExitWin].push_back(index);  // every move loses
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+
+        for (auto& threadQueue : threadQueues) {
+            for (int distance = 0; distance <= MAX_DISTANCE; distance++)
+                queue[distance].insert(queue[distance].end(), threadQueue[distance].begin(), threadQueue[distance].end());
+        }
+    }
+
+    // Then retrograde analysis in order of distance. A position that loses makes every position
+    // leading to it a win one ply further away. A position that wins takes one move away from
+    // each position leading to it, and when a position has no moves left it's lost.
+    int distance = 0;
+    for (; distance <= MAX_DISTANCE; distance++) {
+        for (size_t q = 0; q < queue[distance].size(); q++) {
+            const uint32_t index = queue[distance][q];
+            if (values[index] != UNKNOWN) continue;
+            values[index] = distance + 1;
+
+            const bool lost = (distance % 2 == 0);
+
+            std::array<int, MAX_PIECES> squares;
+            Side sideToPlay;
+            table->decode(index, squares, sideToPlay);
+            const Side mover = (sideToPlay == Side::WHITE) ? Side::BLACK : Side::WHITE;
+
+            // every orientation of the position that has this index, each once
+            std::vector<std::array<int, MAX_PIECES>> orientations;
+            const int transforms = table->pawnless() ? 8 : 2;
+            for (int transform = 0; transform < transforms; transform++) {
+                std::array<int, MAX_PIECES> image = squares;
+                for (size_t i = 0; i < table->pieces().size(); i++) {
+                    int square = image[i];
+                    if (transform & 1) square ^= 7;                             // mirror files
+                    if (transform & 2) square ^= 56;                            // mirror ranks
+                    if (transform & 4) square = (square % 8) * 8 + square / 8;  // mirror along a1-h8
+                    image[i] = square;
+                }
+                if (table->index(image, sideToPlay) != index) continue;
+                if (std::find(orientations.begin(), orientations.end(), image) != orientations.end()) continue;
+                orientations.push_back(image);
+            }
+
+            for (const auto& orientation : orientations) {
+                forEachUnmove(*table, orientation, sideToPlay, [&](const std::array<int, MAX_PIECES>& from) {
+                    // only count the orientation the first pass looked at, otherwise moves get counted twice
+                    if (!canonicalKingSquare(from[0], table->pawnless())) return;
+
+                    const size_t parent = table->index(from, mover);
+                    if (values[parent] != UNKNOWN) return;
+
+                    if (lost) {
+                        if (distance + 1 <= MAX_DISTANCE) queue[distance + 1].push_back(parent);
+                    } else if (--movesLeft[parent] == 0) {
+                        const int lossDistance = std::max<int>(distance, longestExitWin[parent] - 1) + 1;
+                        if (lossDistance <= MAX_DISTANCE) queue[lossDistance].push_back(parent);
+                    }
+                });
+            }
+        }
+        std::vector<uint32_t>().swap(queue[distance]);
+    }
+
+    stats = GenerationStats();
+    for (uint8_t& value : values) {
+        if (value == UNKNOWN) value = DRAW;     // never decided: neither side can force mate
+
+        if (value == ILLEGAL) continue;
+        stats.positions++;
+        if (value == DRAW) stats.draws++;
+        else if (isWin(value)) stats.wins++;
+        else stats.losses++;
+        stats.longest = std::max(stats.longest, value == DRAW ? 0 : distanceOf(value));
+    }
+
+    table->setValues(std::move(values));
+    addLoaded(*table);
+
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    if (!table->save(path + "/" + material + ".ptb"))
+        Log(LogLevel::WARN, "Couldn't save tablebase " + material + " to " + path);
+
+    stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "$tbgen " << material << " positions " << stats.positions << " wins " << stats.wins
+              << " draws " << stats.draws << " losses " << stats.losses << " longest " << stats.longest
+              << " plies time " << (int) stats.ms << " ms" << std::endl;
+    return true;
+}
+
+void bench(const std::string& materials) {
+    std::mt19937 rng(0);
+    size_t start = 0;
+
+    while (start < materials.size()) {
+        size_t end = materials.find(' ', start);
+        if (end == std::string::npos) end = materials.size();
+        const std::string material = canonicalMaterial(materials.substr(start, end - start));
+        start = end + 1;
+        if (material.empty()) continue;
+
+        GenerationStats stats;
+        const std::shared_ptr<Table> table = getTable(material);
+        if (!table->loaded() && !generate(material, stats)) continue;
+
+        // a sample of legal positions, set up as boards before timing
+        std::vector<Board> boards;
+        std::uniform_int_distribution<size_t> randomIndex(0, table->size() - 1);
+        for (int tries = 0; boards.size() < 10000 && tries < 1000000; tries++) {
+            const size_t index = randomIndex(rng);
+            if (table->value(index) == ILLEGAL) continue;
+
+            std::array<Piece, 64> position;
+            Side sideToPlay;
+            table->position(index, position, sideToPlay);
+            boards.emplace_back();
+            boards.back().setUp(position, sideToPlay, false, false, false, false, false, 64);
+        }
+        if (boards.empty()) continue;
+
+        const int repetitions = 20;
+        uint64_t checksum = 0;
+        const auto probeStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < repetitions; i++) {
+            for (const Board& board : boards) {
+                uint8_t value;
+                if (probe(board, value)) checksum += value;
+            }
+        }
+        const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - probeStart).count();
+
+        std::cout << "$tbbench " << material;
+        if (stats.positions > 0) std::cout << " generation " << (int) stats.ms << " ms";
+        std::cout << " probe " << (int) (ns / (repetitions * boards.size())) << " ns"
+                  << " (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+}
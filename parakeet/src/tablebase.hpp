@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "board.hpp"
+#include "mappedfile.hpp"
+
+/* Endgame tablebases for up to 4 pieces (kings included), made by retrograde analysis.
+ *
+ * Each material signature (e.g. KRKP: white king and rook against black king and pawn) gets its
+ * own file, <material>.ptb, which is a 32 byte header followed by one byte per position:
+ *     0           draw
+ *     255         illegal position (also used for indices that don't correspond to a position)
+ *     1 to 254    distance to mate + 1, in plies. Odd distances are wins for the side to play,
+ *                 even ones are losses (0 plies = already checkmated).
+ * The fifty move rule and en passant are ignored.
+ *
+ * The index is [side to play][white king][other pieces in material order], 64 squares for
+ * everything but the white king, which is mirrored onto the a-d files (and for pawnless
+ * material further onto the a1-d1-d4 triangle).
+ */
+namespace tablebase {
+    constexpr int MAX_PIECES = 4;
+    constexpr uint8_t DRAW = 0;
+    constexpr uint8_t ILLEGAL = 255;
+
+    class Table {
+    public:
+        // material like "KRKP", with the stronger side first
+        Table(const std::string& material);
+
+        const std::string& material() const { return m_material; }
+        uint64_t materialKey() const { return m_materialKey; }     // as in Board::materialKey
+        size_t size() const { return m_size; }
+        const std::vector<Piece>& pieces() const { return m_pieces; }
+        bool pawnless() const { return m_pawnless; }
+
+        // squares are given in the order of pieces(). Returns the index after mirroring.
+        size_t index(std::array<int, MAX_PIECES> squares, const Side sideToPlay) const;
+        // false if the index doesn't describe a position (pieces on top of each other)
+        bool decode(size_t index, std::array<int, MAX_PIECES>& squares, Side& sideToPlay) const;
+        bool position(const size_t index, std::array<Piece, 64>& position, Side& sideToPlay) const;
+
+        // values are only available once loaded or generated
+        bool loaded() const { return m_values != nullptr; }
+        uint8_t value(const size_t index) const { return m_values[index]; }
+
+        bool load(const std::string& path);
+        bool save(const std::string& path) const;
+        void setValues(std::vector<uint8_t>&& values);
+
+    private:
+        std::string m_material;
+        uint64_t m_materialKey;
+        std::vector<Piece> m_pieces;    // white king, black king, then the rest
+        bool m_pawnless;
+        int m_kingSquares;              // 10 or 32
+        size_t m_size;
+
+        std::unique_ptr<MappedFile> m_file;
+        std::vector<uint8_t> m_generated;
+        const uint8_t* m_values = nullptr;
+    };
+
+    struct GenerationStats {
+        size_t positions = 0;
+        size_t wins = 0, draws = 0, losses = 0;
+        int longest = 0;    // longest distance to mate in plies
+        double ms = 0;
+    };
+
+    // Directory the tables are read from and written to. Loads every table in it, so nothing may
+    // probe while it runs.
+    void setPath(const std::string& path);
+    const std::string& getPath();
+
+    // Orders the sides so the stronger one is white. Returns an empty string for more than MAX_PIECES.
+    std::string canonicalMaterial(const std::string& material);
+
+    // Generates (and saves) the table for the material, first generating the ones it converts into
+    bool generate(const std::string& material, GenerationStats& stats);
+
+    // Returns false if the position isn't covered by a table that's on disk.
+    // Otherwise value is one of the bytes described above, from the point of view of the side to play.
+    // Doesn't lock or allocate, so the search can call it from any number of threads.
+    bool probe(const Board& board, uint8_t& value);
+
+    // number of pieces on the board, kings included
+    int countPieces(const Board& board);
+
+    // Generates the space separated list of tables (if they aren't on disk yet) and times probing them
+    void bench(const std::string& materials);
+}
@@ -0,0 +1,51 @@
+#include "transpositiontable.hpp"
+
+#include <algorithm>
+
+TranspositionTable::TranspositionTable(const size_t sizeInMB) {
+    resize(sizeInMB);
+}
+
+void TranspositionTable::resize(const size_t sizeInMB) {
+    // round down to a power of two so the index is just a mask
+    size_t entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= sizeInMB * 1024 * 1024) entries *= 2;
+
+    m_entries.assign(entries, TTEntry());
+    m_mask = entries - 1;
+}
+
+void TranspositionTable::clear() {
+    std::fill(m_entries.begin(), m_entries.end(), TTEntry());
+}
+
+const TTEntry* TranspositionTable::probe(const uint64_t key) const {
+    const TTEntry& entry = m_entries[key & m_mask];
+    if (entry.bound != Bound::NONE && entry.key == key) return &entry;
+    return nullptr;
+}
+
+void TranspositionTable::store(const uint64_t key, const int depth, const int eval, const Bound bound, const uint16_t move) {
+    TTEntry& entry = m_entries[key & m_mask];
+
+    // keep deeper results for the same position, otherwise always replace
+    if (entry.key == key && entry.depth > depth && bound != Bound::EXACT) return;
+
+    // don't lose a known best move to a fail-low that doesn't have one
+    const uint16_t keptMove = (move == 0 && entry.key == key) ? entry.move : move;
+
+    entry.key = key;
+    entry.depth = depth;
+    entry.eval = eval;
+    entry.bound = bound;
+    entry.move = keptMove;
+}
+
+int TranspositionTable::hashfull() const {
+    const size_t sample = std::min<size_t>(1000, m_entries.size());
+    int used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        if (m_entries[i].bound != Bound::NONE) used++;
+    }
+    return (int) (used * 1000 / sample);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class Bound : uint8_t {
+    NONE, EXACT, LOWER, UPPER
+};
+
+struct TTEntry {
+    uint64_t key = 0;
+    int32_t eval = 0;
+    uint16_t move = 0;  // Move::encode(), 0 if there is none
+    int8_t depth = -1;
+    Bound bound = Bound::NONE;
+};
+
+class TranspositionTable {
+public:
+    TranspositionTable(const size_t sizeInMB = 16);
+
+    void resize(const size_t sizeInMB);
+    void clear();
+
+    // returns nullptr if the position isn't stored
+    const TTEntry* probe(const uint64_t key) const;
+    void store(const uint64_t key, const int depth, const int eval, const Bound bound, const uint16_t move);
+
+    // permille of a sample of entries which are in use (like UCI's hashfull)
+    int hashfull() const;
+
+    const std::vector<TTEntry>& entries() const { return m_entries; }
+
+private:
+    std::vector<TTEntry> m_entries;
+    uint64_t m_mask;
+};
@@ -0,0 +1,291 @@
+#include "tune.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "positionfile.hpp"
+#include "log.hpp"
+
+#include <cmath>
+#include <array>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+
+namespace tune {
+namespace {
+    // The pieces whose values are in the evaluation, and the order they're kept in here
+    constexpr std::array<PieceType, 5> PIECES = {
+        PieceType::QUEEN, PieceType::ROOK, PieceType::BISHOP, PieceType::KNIGHT, PieceType::PAWN
+    };
+    constexpr int TUNED = 4;    // the first four; the pawn sets the scale
+    constexpr int MAX_QUIESCENCE_PLY = 12;
+
+    // The piece values only enter Engine::evaluate through the material balance, which is linear in
+    // them, so a position is how many more of each piece white has plus the rest of the evaluation
+    // (the attack map terms and the endgame corrections) at the values the samples were made with,
+    // kept fixed. The activity terms grow with the material, so fitting the material alone would
+    // push their share into the values. 8 bytes instead of a Board.
+    struct Sample {
+        std::array<int8_t, 5> counts;   // white's minus black's, in the order of PIECES
+        uint8_t result;                 // for white, in half points: 0, 1 or 2
+        int16_t offset;                 // Engine::evaluate minus the material, for white
+    };
+    static_assert(sizeof(Sample) == 8, "samples should be 8 bytes");
+
+    using Counts = std::array<int8_t, 5>;
+
+    Counts countPieces(const Board& board) {
+        Counts counts = {};
+        for (const Piece& piece : board.position) {
+            for (size_t i = 0; i < PIECES.size(); i++) {
+                if (piece.type == PIECES[i]) counts[i] += (piece.side == Side::WHITE) ? 1 : -1;
+            }
+        }
+        return counts;
+    }
+
+    // Captures and promotions only, with the option of standing pat on Engine::evaluate, from the
+    // side to play's point of view. leaf is set to the sample (without its result) of the position
+    // the best line ends in.
+    int quiesce(const Engine& engine, const Board& board, int alpha, const int beta, const int ply, Sample& leaf) {
+        const int standPat = engine.evaluate(board);
+        const int whiteEval = (board.sideToPlay == Side::WHITE) ? standPat : -standPat;
+        leaf.counts = countPieces(board);
+        leaf.offset = (int16_t) std::max(-32768, std::min(whiteEval - board.materialDifference, 32767));
+        if (standPat >= beta || ply >= MAX_QUIESCENCE_PLY) return standPat;
+        alpha = std::max(alpha, standPat);
+
+        std::vector<Move> moves;
+        board.generateAllMoves(moves);
+
+        // most valuable victim first, then least valuable attacker, so the cutoffs come early
+        const PieceValues& pieceValues = board.getPieceValues();
+        const auto gain = [&](const Move& move) {
+            const PieceType victim = move.isEnPassant() ? PieceType::PAWN : board.position[move.after].type;
+            return (move.capture ? pieceValues[victim] * 16 : 0) - pieceValues[board.position[move.before].type] / 16
+                + (move.promotion ? pieceValues[PieceType::QUEEN] : 0);
+        };
+        moves.erase(std::remove_if(moves.begin(), moves.end(), [](const Move& move) {
+            return !move.capture && !move.promotion;
+        }), moves.end());
+        std::sort(moves.begin(), moves.end(), [&](const Move& a, const Move& b) { return gain(a) > gain(b); });
+
+        for (const Move& move : moves) {
+            Board newBoard = board;
+            newBoard.makeMove(move);
+
+            Sample newLeaf;
+            const int eval = -quiesce(engine, newBoard, -beta, -alpha, ply + 1, newLeaf);
+            if (eval > alpha) {
+                alpha = eval;
+                leaf = newLeaf;
+                if (eval >= beta) break;
+            }
+        }
+        return alpha;
+    }
+
+    // Calls work(begin, end, thread) on the parts of [0, size) on all the threads
+    template<typename F>
+    void parallelFor(const unsigned int threads, const size_t size, F work) {
+        std::vector<std::thread> workers;
+        for (unsigned int thread = 0; thread < threads; thread++) {
+            const size_t begin = size * thread / threads;
+            const size_t end = size * (thread + 1) / threads;
+            workers.emplace_back([&work, begin, end, thread]() { work(begin, end, thread); });
+        }
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    std::vector<Sample> loadSamples(PositionReader& reader, const unsigned int threads) {
+        std::vector<PackedPosition> records;
+        records.reserve(reader.size());
+        const PackedPosition* block;
+        for (size_t count = reader.nextBlock(block); count > 0; count = reader.nextBlock(block)) {
+            records.insert(records.end(), block, block + count);
+        }
+
+        // evaluate is const, so the threads share one engine at the default values
+        const Engine engine;
+        std::vector<Sample> samples(records.size());
+        std::vector<uint8_t> keep(records.size(), 0);
+
+        parallelFor(threads, records.size(), [&](const size_t begin, const size_t end, unsigned int) {
+            Board board;
+            for (size_t i = begin; i < end; i++) {
+                const PackedPosition& record = records[i];
+                if (record.result == PackedPosition::NO_RESULT || !board.unpack(record)) continue;
+                if (board.check.at(board.sideToPlay)) continue;     // not quiet, and standing pat isn't allowed
+
+                Sample leaf;
+                quiesce(engine, board, -1000000, 1000000, 0, leaf);
+
+                samples[i] = leaf;
+                samples[i].result = (uint8_t) (record.result + 1);
+                keep[i] = 1;
+            }
+        });
+
+        size_t kept = 0;
+        for (size_t i = 0; i < samples.size(); i++) {
+            if (keep[i]) samples[kept++] = samples[i];
+        }
+        samples.resize(kept);
+        samples.shrink_to_fit();
+        return samples;
+    }
+
+    struct Evaluation {
+        double error = 0;
+        std::array<double, 5> gradient = {};
+    };
+
+    // Mean squared error of the predictions over all samples, and its gradient by the values
+    Evaluation evaluate(const std::vector<Sample>& samples, const std::array<double, 5>& values,
+                        const double k, const unsigned int threads) {
+        const double scale = k * std::log(10.0) / 400;
+        std::vector<Evaluation> parts(threads);
+
+        parallelFor(threads, samples.size(), [&](const size_t begin, const size_t end, const unsigned int thread) {
+            Evaluation& part = parts[thread];
+            for (size_t i = begin; i < end; i++) {
+                const Sample& sample = samples[i];
+
+                double eval = sample.offset;
+                for (size_t piece = 0; piece < values.size(); piece++) eval += values[piece] * sample.counts[piece];
+
+                const double prediction = 1 / (1 + std::exp(-scale * eval));
+                const double difference = sample.result * 0.5 - prediction;
+                part.error += difference * difference;
+
+                const double slope = -2 * difference * prediction * (1 - prediction) * scale;
+                for (size_t piece = 0; piece < values.size(); piece++) part.gradient[piece] += slope * sample.counts[piece];
+            }
+        });
+
+        Evaluation total;
+        for (const Evaluation& part : parts) {
+            total.error += part.error;
+            for (size_t piece = 0; piece < values.size(); piece++) total.gradient[piece] += part.gradient[piece];
+        }
+        const double count = std::max<double>(1, samples.size());
+        total.error /= count;
+        for (double& gradient : total.gradient) gradient /= count;
+        return total;
+    }
+
+    // K is fitted to the starting values by golden section search, so the error is on a fair scale
+    double fitK(const std::vector<Sample>& samples, const std::array<double, 5>& values, const unsigned int threads) {
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double low = 0.01, high = 5;
+        for (int i = 0; i < 40; i++) {
+            const double a = high - ratio * (high - low);
+            const double b = low + ratio * (high - low);
+            if (evaluate(samples, values, a, threads).error < evaluate(samples, values, b, threads).error) high = b;
+            else low = a;
+        }
+        return (low + high) / 2;
+    }
+
+    PieceValues toPieceValues(const std::array<double, 5>& values) {
+        PieceValues out = DEFAULT_PIECE_VALUES;
+        for (size_t piece = 0; piece < PIECES.size(); piece++) out[PIECES[piece]] = (int) std::lround(values[piece]);
+        return out;
+    }
+
+    double secondsSince(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int run(int argc, char* argv[]) {
+    std::string path, outPath = "piecevalues.txt";
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    int iterations = 1000;
+    double rate = 1.0;
+
+    for (int i = 0; i < argc; i++) {
+        const std::string arg = argv[i];
+        try {
+            if (arg.rfind("threads=", 0) == 0) threads = std::max(1, std::stoi(arg.substr(8)));
+            else if (arg.rfind("iterations=", 0) == 0) iterations = std::max(0, std::stoi(arg.substr(11)));
+            else if (arg.rfind("rate=", 0) == 0) rate = std::stod(arg.substr(5));
+            else if (arg.rfind("out=", 0) == 0) outPath = arg.substr(4);
+            else path = arg;
+        } catch (const std::exception&) {
+            Log(LogLevel::ERROR, "Bad tune argument " + arg);
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        Log(LogLevel::ERROR, "Usage: parakeet tune <positions> [threads=N] [iterations=N] [rate=X] [out=<file>]");
+        return 1;
+    }
+
+    const std::unique_ptr<PositionReader> reader = PositionReader::open(path);
+    if (!reader) {
+        Log(LogLevel::ERROR, "Couldn't read " + path + " as a position file");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<Sample> samples = loadSamples(*reader, threads);
+    std::cout << "$tune positions " << reader->size() << " samples " << samples.size()
+              << " load " << (int) (secondsSince(start) * 1000) << " ms" << std::endl;
+    if (samples.empty()) {
+        Log(LogLevel::ERROR, "No positions with results to tune on");
+        return 1;
+    }
+
+    std::array<double, 5> values;
+    for (size_t piece = 0; piece < PIECES.size(); piece++) values[piece] = DEFAULT_PIECE_VALUES[PIECES[piece]];
+
+    const double k = fitK(samples, values, threads);
+
+    start = std::chrono::steady_clock::now();
+    const double startError = evaluate(samples, values, k, threads).error;
+    const double passMs = secondsSince(start) * 1000;
+    std::cout << "$tune k " << k << " error " << startError << " pass " << passMs << " ms"
+              << " (" << (uint64_t) (samples.size() / std::max(passMs, 0.001) * 1000) << " positions/s)"
+              << " values " << pieceValuesString(toPieceValues(values)) << std::endl;
+
+    // Adam (https://arxiv.org/abs/1412.6980), with rate in centipawns per step
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-12;
+    std::array<double, 5> moment = {}, velocity = {};
+    double error = startError;
+
+    start = std::chrono::steady_clock::now();
+    for (int iteration = 1; iteration <= iterations; iteration++) {
+        const Evaluation evaluation = evaluate(samples, values, k, threads);
+        error = evaluation.error;
+
+        for (int piece = 0; piece < TUNED; piece++) {
+            const double gradient = evaluation.gradient[piece];
+            moment[piece] = beta1 * moment[piece] + (1 - beta1) * gradient;
+            velocity[piece] = beta2 * velocity[piece] + (1 - beta2) * gradient * gradient;
+
+            const double correctedMoment = moment[piece] / (1 - std::pow(beta1, iteration));
+            const double correctedVelocity = velocity[piece] / (1 - std::pow(beta2, iteration));
+            values[piece] -= rate * correctedMoment / (std::sqrt(correctedVelocity) + epsilon);
+            values[piece] = std::max(values[piece], 1.0);
+        }
+
+        if (iteration % 100 == 0 || iteration == iterations) {
+            std::cout << "$tune iteration " << iteration << " error " << error
+                      << " values " << pieceValuesString(toPieceValues(values)) << std::endl;
+        }
+    }
+    error = evaluate(samples, values, k, threads).error;
+
+    const PieceValues tuned = toPieceValues(values);
+    const std::string comment = "parakeet tune on " + std::to_string(samples.size()) + " positions of " + path
+        + ", error " + std::to_string(startError) + " -> " + std::to_string(error);
+    if (!writePieceValues(outPath, tuned, comment)) return 1;
+
+    std::cout << "$tune done error " << error << " time " << (int) (secondsSince(start) * 1000) << " ms"
+              << " values " << pieceValuesString(tuned) << " written to " << outPath << std::endl;
+    return 0;
+}
+}
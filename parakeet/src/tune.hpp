@@ -0,0 +1,16 @@
+#pragma once
+
+/* Texel tuning of the piece values:
+ *     parakeet tune <positions> [threads=N] [iterations=N] [rate=X] [out=<file>]
+ *
+ * Loads a position file with game results (e.g. from parakeet selfplay), resolves every position
+ * with a capture-only search on the full evaluation, and fits the values so that the evaluation
+ * (the material plus the rest of it, held fixed at the default values) predicts the results:
+ * the mean of (result - sigmoid(K * eval))^2 is minimised, first over K and then over the values
+ * with Adam. The pawn is kept at its value to fix the scale. The values are written to out
+ * (piecevalues.txt by default) for $values to load.
+ */
+namespace tune {
+    // argv without the program name and "tune". Returns the exit code.
+    int run(int argc, char* argv[]);
+}
@@ -1,5 +0,0 @@
-#pragma once
-
-struct Coordinate {
-    int x; int y;
-};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "piece.hpp"
+
+/* A material signature: how many pieces of each type each side has, in 4 bits per count. White's
+ * counts are in the low 32 bits and black's in the high ones, indexed by PieceType. Kings aren't
+ * counted. Board keeps one up to date (Board::materialKey) and it picks the endgame evaluation.
+ */
+namespace material {
+    constexpr int shift(const Side side, const PieceType type) {
+        return ((int)side * 8 + (int)type) * 4;
+    }
+
+    // what a piece adds to the key
+    constexpr uint64_t unit(const Piece& piece) {
+        return (piece.type == PieceType::EMPTY || piece.type == PieceType::KING) ? 0 : uint64_t(1) << shift(piece.side, piece.type);
+    }
+
+    constexpr int count(const uint64_t key, const Side side, const PieceType type) {
+        return (key >> shift(side, type)) & 15;
+    }
+
+    // all of both sides' counts of a type
+    constexpr uint64_t mask(const PieceType type) {
+        return (uint64_t(15) << shift(Side::WHITE, type)) | (uint64_t(15) << shift(Side::BLACK, type));
+    }
+
+    // the same material with the colours swapped
+    constexpr uint64_t mirror(const uint64_t key) {
+        return (key >> 32) | (key << 32);
+    }
+
+    // Key of a signature like "KBNK": the white pieces after the first K, the black ones after the second
+    constexpr uint64_t key(const std::string_view signature) {
+        uint64_t out = 0;
+        Side side = Side::WHITE;
+        for (size_t i = 0; i < signature.size(); i++) {
+            PieceType type = PieceType::EMPTY;
+            switch (signature[i]) {
+                case 'K': if (i > 0) side = Side::BLACK; break;
+                case 'Q': type = PieceType::QUEEN; break;
+                case 'R': type = PieceType::ROOK; break;
+                case 'B': type = PieceType::BISHOP; break;
+                case 'N': type = PieceType::KNIGHT; break;
+                case 'P': type = PieceType::PAWN; break;
+            }
+            out += unit({type, side});
+        }
+        return out;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+/* A position in 32 bytes, for datasets and streaming (see Board::pack and positionfile.hpp).
+ *
+ * occupancy has a bit for every square with a piece on it (a1 = bit 0). The pieces follow in the
+ * same order, lowest square first, 4 bits each: the low nibble of a byte comes first. A piece is
+ * its PieceType, plus 8 if it is black. The struct is written to files as it is in memory
+ * (little endian).
+ */
+struct PackedPosition {
+    static constexpr uint8_t BLACK_TO_PLAY = 1;
+    static constexpr uint8_t WHITE_KING_SIDE = 2;
+    static constexpr uint8_t WHITE_QUEEN_SIDE = 4;
+    static constexpr uint8_t BLACK_KING_SIDE = 8;
+    static constexpr uint8_t BLACK_QUEEN_SIDE = 16;
+
+    static constexpr int8_t NO_RESULT = -128;
+    static constexpr int16_t NO_SCORE = -32768;
+
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t flags;              // side to play and castling rights, from the constants above
+    uint8_t enPassant;          // square of the pawn that can be taken en passant, 64 if none
+    uint8_t halfmoveClock;      // capped at 255
+    int8_t result;              // of the game the position is from, for white: 1, 0 or -1. NO_RESULT if unknown
+    uint16_t fullmoveNumber;
+    int16_t score;              // in centipawns for the side to play, NO_SCORE if it hasn't been searched
+};
+static_assert(sizeof(PackedPosition) == 32, "packed positions should be 32 bytes");
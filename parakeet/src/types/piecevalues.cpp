@@ -0,0 +1,70 @@
+#include "piecevalues.hpp"
+#include "../log.hpp"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+    struct NamedPiece {
+        const char* name;
+        PieceType type;
+    };
+    constexpr NamedPiece PIECES[] = {
+        {"queen", PieceType::QUEEN}, {"rook", PieceType::ROOK}, {"bishop", PieceType::BISHOP},
+        {"knight", PieceType::KNIGHT}, {"pawn", PieceType::PAWN}
+    };
+}
+
+bool readPieceValues(const std::string& path, PieceValues& out) {
+    std::ifstream file(path);
+    if (!file) {
+        Log(LogLevel::WARN, "Couldn't open piece values " + path);
+        return false;
+    }
+
+    PieceValues values = out;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string name;
+        int value;
+        if (!(stream >> name) || name[0] == '#') continue;
+
+        bool known = false;
+        for (const NamedPiece& piece : PIECES) {
+            if (name != piece.name) continue;
+            known = true;
+            if (!(stream >> value) || value <= 0) {
+                Log(LogLevel::WARN, "Bad value for " + name + " in " + path);
+                return false;
+            }
+            values[piece.type] = value;
+        }
+        if (!known) {
+            Log(LogLevel::WARN, "Unknown piece " + name + " in " + path);
+            return false;
+        }
+    }
+    out = values;
+    return true;
+}
+
+bool writePieceValues(const std::string& path, const PieceValues& values, const std::string& comment) {
+    std::ofstream file(path);
+    if (!comment.empty()) file << "# " << comment << "\n";
+    for (const NamedPiece& piece : PIECES) file << piece.name << " " << values[piece.type] << "\n";
+    if (!file.good()) {
+        Log(LogLevel::WARN, "Couldn't write piece values " + path);
+        return false;
+    }
+    return true;
+}
+
+std::string pieceValuesString(const PieceValues& values) {
+    std::string out;
+    for (const NamedPiece& piece : PIECES) {
+        if (!out.empty()) out += " ";
+        out += std::string(piece.name) + " " + std::to_string(values[piece.type]);
+    }
+    return out;
+}
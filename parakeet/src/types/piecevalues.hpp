@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "piecetype.hpp"
+
+// Material value of each piece type, in centipawns
+struct PieceValues {
+    std::array<int, 7> values; // indexed by PieceType
+
+    constexpr int operator[](const PieceType type) const { return values[(int)type]; }
+    int& operator[](const PieceType type) { return values[(int)type]; }
+};
+
+//                                            EMPTY  KING     QUEEN BISHOP KNIGHT ROOK PAWN
+constexpr PieceValues DEFAULT_PIECE_VALUES = {{0,    1000000, 900,  350,   300,   500, 100}};
+
+// Piece values as text, one "<piece> <centipawns>" line per piece (queen, rook, bishop, knight, pawn).
+// Lines starting with # are comments, and pieces that aren't given keep their value in out.
+bool readPieceValues(const std::string& path, PieceValues& out);
+bool writePieceValues(const std::string& path, const PieceValues& values, const std::string& comment = "");
+std::string pieceValuesString(const PieceValues& values);
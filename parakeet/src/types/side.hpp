@@ -1,5 +1,24 @@
 #pragma once
 
+#include <array>
+
 enum class Side {
     WHITE = 0, BLACK = 1, EMPTY
-};
\ No newline at end of file
+};
+
+// the other side (not meant for Side::EMPTY)
+constexpr Side opponentOf(const Side side) {
+    return (side == Side::WHITE) ? Side::BLACK : Side::WHITE;
+}
+
+// One T for each side, indexed by Side. A plain array, so copying a board (done at every node of
+// the search) doesn't allocate.
+template <typename T>
+struct BySide {
+    std::array<T, 2> values{};
+
+    T& operator[](const Side side) { return values[(int)side]; }
+    const T& operator[](const Side side) const { return values[(int)side]; }
+    T& at(const Side side) { return values[(int)side]; }
+    const T& at(const Side side) const { return values[(int)side]; }
+};
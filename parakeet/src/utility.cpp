@@ -1,177 +1,261 @@
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 
 #include "utility.hpp"
 #include "log.hpp"
 
-static std::vector<std::string> split(std::string& text, const char& delimiter) {
-    std::vector<std::string> words;
-
-    std::string current_word = "";
-    for (const char& c : text) {
-        if (c == delimiter) {
-            if (current_word != "") {
-                words.push_back(current_word);
-                current_word = "";
-            }
-        } else {
-            current_word += c;
+namespace {
+    Piece pieceFromLetter(const char c) {
+        const Side side = (c >= 'a') ? Side::BLACK : Side::WHITE;
+        switch (c | 0x20) {   // lower case
+            case 'p': return {PieceType::PAWN,   side};
+            case 'n': return {PieceType::KNIGHT, side};
+            case 'b': return {PieceType::BISHOP, side};
+            case 'r': return {PieceType::ROOK,   side};
+            case 'q': return {PieceType::QUEEN,  side};
+            case 'k': return {PieceType::KING,   side};
         }
+        return EMPTY_SQUARE;
     }
 
-    if (current_word != "") {
-        words.push_back(current_word);
-        current_word = "";
+    char letterFromPiece(const Piece& piece) {
+        const char letter = ".kqbnrp"[(int)piece.type];
+        return (piece.side == Side::WHITE) ? letter - 'a' + 'A' : letter;
     }
-
-    return words;
 }
 
-static void logFENPosition(std::array<Piece, 64>& position) {
-
-    std::string out = "\n";
-    for (int i = 56; i >= 0; i++) {
-        if (position[i].side == Side::WHITE) {
-            if (position[i].type == PieceType::PAWN) out += "P";
-            else if (position[i].type == PieceType::ROOK) out += "R";
-            else if (position[i].type == PieceType::KNIGHT) out += "N";
-            else if (position[i].type == PieceType::BISHOP) out += "B";
-            else if (position[i].type == PieceType::QUEEN) out += "Q";
-            else if (position[i].type == PieceType::KING) out += "K";
+bool loadFEN(std::string_view fen, Board& board, const char** error) {
+    const auto fail = [&](const char* message) {
+        if (error != nullptr) *error = message;
+        return false;
+    };
+
+    size_t i = 0;
+    const auto nextField = [&]() {
+        while (i < fen.size() && fen[i] == ' ') i++;
+        const size_t start = i;
+        while (i < fen.size() && fen[i] != ' ') i++;
+        return fen.substr(start, i - start);
+    };
+
+    // 0 = piece placement, from a8 to h8, then rank 7 and so on
+    std::array<Piece, 64> position;
+    position.fill(EMPTY_SQUARE);
+
+    int rank = 7, file = 0, whiteKings = 0, blackKings = 0;
+    BySide<int> kings;
+    for (const char c : nextField()) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) return fail("bad piece placement");
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8) return fail("bad piece placement");
         } else {
-            if (position[i].type == PieceType::PAWN) out += "p";
-            else if (position[i].type == PieceType::ROOK) out += "r";
-            else if (position[i].type == PieceType::KNIGHT) out += "n";
-            else if (position[i].type == PieceType::BISHOP) out += "b";
-            else if (position[i].type == PieceType::QUEEN) out += "q";
-            else if (position[i].type == PieceType::KING) out += "k";
-            else if (position[i].type == PieceType::EMPTY) out += ".";
-        } 
-
-        if ((i+1)%8 == 0) {
-            out += "\n";
-            i -= 16;
+            const Piece piece = pieceFromLetter(c);
+            if (piece.type == PieceType::EMPTY || file >= 8) return fail("bad piece placement");
+            if (piece.type == PieceType::PAWN && (rank == 0 || rank == 7)) return fail("pawn on the first or last rank");
+            if (piece.type == PieceType::KING) {
+                (piece.side == Side::WHITE ? whiteKings : blackKings)++;
+                kings[piece.side] = rank*8 + file;
+            }
+
+            position[rank*8 + file++] = piece;
         }
     }
+    if (rank != 0 || file != 8) return fail("bad piece placement");
+    if (whiteKings != 1 || blackKings != 1) return fail("each side needs exactly one king");
 
-    Log(LogLevel::DEBUG, out);
-}
-
-void loadFEN(std::string fen, Board& board) {
-    std::unordered_map<char, Piece> pieceRef;
-    pieceRef['p'] = {PieceType::PAWN,   Side::BLACK};
-    pieceRef['r'] = {PieceType::ROOK,   Side::BLACK};
-    pieceRef['n'] = {PieceType::KNIGHT, Side::BLACK};
-    pieceRef['b'] = {PieceType::BISHOP, Side::BLACK};
-    pieceRef['q'] = {PieceType::QUEEN,  Side::BLACK};
-    pieceRef['k'] = {PieceType::KING,   Side::BLACK};
-    pieceRef['R'] = {PieceType::ROOK,   Side::WHITE};
-    pieceRef['P'] = {PieceType::PAWN,   Side::WHITE};
-    pieceRef['N'] = {PieceType::KNIGHT, Side::WHITE};
-    pieceRef['B'] = {PieceType::BISHOP, Side::WHITE};
-    pieceRef['Q'] = {PieceType::QUEEN,  Side::WHITE};
-    pieceRef['K'] = {PieceType::KING,   Side::WHITE};
-
-    // 0 = piece placement
     // 1 = active colour
+    const std::string_view colour = nextField();
+    if (colour != "w" && colour != "b") return fail("bad side to move");
+    const Side sideToPlay = (colour == "w") ? Side::WHITE : Side::BLACK;
+    // the side that just moved can't have left its king attacked (this only reads position)
+    if (board.sideInCheck(opponentOf(sideToPlay), position, kings)) return fail("the side not to move is in check");
+
     // 2 = castling rights
-    // 3 = possible en passant targets
-    // 4 = halfmove clock
-    // 5 = fullmove number
-    // (separated by spaces)
+    bool whiteKingSide = false, whiteQueenSide = false, blackKingSide = false, blackQueenSide = false;
+    const std::string_view castling = nextField();
+    if (castling.empty()) return fail("missing castling rights");
+    for (const char c : castling) {
+        if (c == 'K') whiteKingSide = true;
+        else if (c == 'Q') whiteQueenSide = true;
+        else if (c == 'k') blackKingSide = true;
+        else if (c == 'q') blackQueenSide = true;
+        else if (c != '-') return fail("bad castling rights");
+    }
 
-    std::array<Piece, 64> position;
-    for (int i = 0; i < 64; i++) {
-        position[i] = EMPTY_SQUARE;
+    // a right needs the king and that rook still on their starting squares
+    const auto isPiece = [&](const int square, const PieceType type, const Side side) {
+        return position[square].type == type && position[square].side == side;
+    };
+    const auto canCastle = [&](const Side side, const int rook) {
+        const int home = (side == Side::WHITE) ? 0 : 56;
+        return isPiece(home + 4, PieceType::KING, side) && isPiece(home + rook, PieceType::ROOK, side);
+    };
+    if ((whiteKingSide && !canCastle(Side::WHITE, 7)) || (whiteQueenSide && !canCastle(Side::WHITE, 0))
+            || (blackKingSide && !canCastle(Side::BLACK, 7)) || (blackQueenSide && !canCastle(Side::BLACK, 0)))
+        return fail("castling rights without the king and rook on their squares");
+
+    // 3 = possible en passant target (https://www.chess.com/terms/fen-chess)
+    // Board keeps the square of the pawn that moved, and whether a pawn of ours is next to it
+    bool enPassantPossible = false;
+    unsigned short lastDoublePawnPush = 64;
+
+    const std::string_view enPassant = nextField();
+    if (enPassant != "-") {
+        // the square the opponent's pawn skipped: on the 6th rank if white is to play, the 3rd if black is
+        if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h'
+                || enPassant[1] != ((sideToPlay == Side::WHITE) ? '6' : '3'))
+            return fail("bad en passant square");
+
+        const int enPassantFile = enPassant[0] - 'a';
+        lastDoublePawnPush = ((sideToPlay == Side::WHITE) ? 4 : 3) * 8 + enPassantFile;
+        if (!isPiece(lastDoublePawnPush, PieceType::PAWN, opponentOf(sideToPlay)))
+            return fail("no pawn that could have just moved two squares for the en passant square");
+
+        enPassantPossible = (enPassantFile > 0 && isPiece(lastDoublePawnPush-1, PieceType::PAWN, sideToPlay))
+                         || (enPassantFile < 7 && isPiece(lastDoublePawnPush+1, PieceType::PAWN, sideToPlay));
     }
 
-    std::vector<std::string> info = split(fen, ' ');
-    
+    // 4 = halfmove clock, 5 = fullmove number. Both optional (EPD doesn't have them) and
+    // anything after them (like EPD operations) is left to the caller.
+    const auto readNumber = [](const std::string_view field, int& out) {
+        if (field.empty() || field.size() > 6) return false;
+        int value = 0;
+        for (const char c : field) {
+            if (c < '0' || c > '9') return false;
+            value = value*10 + (c - '0');
+        }
+        out = value;
+        return true;
+    };
+
+    int halfmoveClock = 0, fullmoveNumber = 1;
+    const size_t beforeClocks = i;
+    if (readNumber(nextField(), halfmoveClock)) {
+        if (!readNumber(nextField(), fullmoveNumber)) fullmoveNumber = 1;
+    } else {
+        i = beforeClocks;
+    }
 
-    // Piece placement
-    std::vector<std::string> piece_placement = split(info[0], '/');
+    board.setUp(
+        position, sideToPlay,
+        whiteKingSide, whiteQueenSide, blackKingSide, blackQueenSide,
+        enPassantPossible, lastDoublePawnPush, halfmoveClock, std::max(1, fullmoveNumber)
+    );
+    return true;
+}
+
+size_t writeFEN(const Board& board, char* buffer, const size_t size, const bool epd) {
+    char out[128];
+    size_t length = 0;
 
     for (int rank = 7; rank >= 0; rank--) {
-        int file = 0;
-        for (const char& c : piece_placement[7-rank]) {
-            if (isdigit(c)) file += c-'0';
-            else {
-                position[rank*8 + file] = pieceRef.at(c);
-                file++;
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            const Piece& piece = board.position[rank*8 + file];
+            if (piece.type == PieceType::EMPTY) {
+                empty++;
+                continue;
             }
+            if (empty > 0) out[length++] = '0' + empty;
+            empty = 0;
+            out[length++] = letterFromPiece(piece);
         }
+        if (empty > 0) out[length++] = '0' + empty;
+        if (rank > 0) out[length++] = '/';
     }
-    Log(LogLevel::DEBUG, "Generated FEN Position:");
-    logFENPosition(position);
 
-    // Active colour
-    Side active_colour;
-    if (info[1] == "w") {
-        active_colour = Side::WHITE;
-        Log(LogLevel::INFO, "FEN reader says active colour white");
+    out[length++] = ' ';
+    out[length++] = (board.sideToPlay == Side::WHITE) ? 'w' : 'b';
+    out[length++] = ' ';
+
+    const size_t castlingStart = length;
+    if (board.castlingRightsKingSide.at(Side::WHITE))  out[length++] = 'K';
+    if (board.castlingRightsQueenSide.at(Side::WHITE)) out[length++] = 'Q';
+    if (board.castlingRightsKingSide.at(Side::BLACK))  out[length++] = 'k';
+    if (board.castlingRightsQueenSide.at(Side::BLACK)) out[length++] = 'q';
+    if (length == castlingStart) out[length++] = '-';
+
+    // only given when it could be taken, so the same position always gives the same FEN
+    out[length++] = ' ';
+    if (board.enPassantCapturePossible()) {
+        const int pawn = board.lastDoublePawnPush;
+        const int target = (board.sideToPlay == Side::WHITE) ? pawn + 8 : pawn - 8;
+        out[length++] = 'a' + target % 8;
+        out[length++] = '1' + target / 8;
     } else {
-        active_colour = Side::BLACK;
-        Log(LogLevel::INFO, "FEN reader says active colour black");
+        out[length++] = '-';
     }
 
-    // Castling rights
-    bool whiteCanCastleKingSide = false;
-    bool whiteCanCastleQueenSide = false;
-    bool blackCanCastleKingSide = false;
-    bool blackCanCastleQueenSide = false;
-
-    for (const char& c : info[2]) {
-        if (c == 'K') whiteCanCastleKingSide = true;
-        else if (c == 'Q') whiteCanCastleQueenSide = true;
-        else if (c == 'k') blackCanCastleKingSide = true;
-        else if (c == 'q') blackCanCastleQueenSide = true;
+    if (!epd) {
+        const auto writeNumber = [&](int value) {
+            char digits[12];
+            int count = 0;
+            do {
+                digits[count++] = '0' + value % 10;
+                value /= 10;
+            } while (value > 0 && count < 12);
+            while (count > 0) out[length++] = digits[--count];
+        };
+        out[length++] = ' ';
+        writeNumber(std::max(0, board.halfmoveClock));
+        out[length++] = ' ';
+        writeNumber(std::max(1, board.fullmoveNumber));
     }
 
-    // Possible En Passant Targets
-    // https://www.chess.com/terms/fen-chess
-    bool enPassantPossible = false;
-    unsigned short lastDoublePawnPush = 64;
-
-    if (info[3] != "-") {
-        int possibleEnPassantFile = info[3][0] - 'a';
+    if (length + 1 > size) return 0;
+    std::memcpy(buffer, out, length);
+    buffer[length] = '\0';
+    return length;
+}
 
-        int enPassantRank;
-        int offset;
-        if (active_colour == Side::WHITE) {
-            enPassantRank = 4;
-            offset = -1;
-        } else {
-            enPassantRank = 3;
-            offset = 1;
-        }
+std::string getFEN(const Board& board, const bool epd) {
+    char buffer[128];
+    return std::string(buffer, writeFEN(board, buffer, sizeof(buffer), epd));
+}
 
-        lastDoublePawnPush = enPassantRank*8 + possibleEnPassantFile;
-        if (possibleEnPassantFile > 0 && position[lastDoublePawnPush-1].side == active_colour
-                && position[lastDoublePawnPush-1].type == PieceType::PAWN) {
-            enPassantPossible = true;
-            Log(LogLevel::INFO, "FEN reader says en passant possible");
+void benchFEN() {
+    const std::vector<std::string> fens = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"
+    };
+    const int rounds = 50000;
+
+    Board board;
+    size_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const std::string& fen : fens) {
+            loadFEN(fen, board);
+            checksum += board.hash & 1;
         }
-
-        if (possibleEnPassantFile < 7 && position[lastDoublePawnPush+1].side == active_colour
-                && position[lastDoublePawnPush+1].type == PieceType::PAWN) {
-            enPassantPossible = true;
-            Log(LogLevel::INFO, "FEN reader says en passant possible");
+    }
+    const double readMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    char buffer[128];
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (const std::string& fen : fens) {
+            if (round == 0) loadFEN(fen, board);    // positions are loaded once, then just written
+            checksum += writeFEN(board, buffer, sizeof(buffer));
         }
-
     }
+    const double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    // Halfmove clock
-
-
-    // Fullmove number
-
-
-    // Generate & return board (pointer?)
-    board = Board(
-        position, active_colour,
-        whiteCanCastleKingSide, whiteCanCastleQueenSide,
-        blackCanCastleKingSide, blackCanCastleQueenSide,
-        enPassantPossible, lastDoublePawnPush
-    );
+    const double positions = (double) rounds * fens.size();
+    std::cout << "$fenbench read " << (uint64_t)(positions / readMs * 1000) << " positions/s"
+              << " write " << (uint64_t)(positions / writeMs * 1000) << " positions/s"
+              << " (checksum " << checksum << ")" << std::endl;
 }
 
 std::string getPositionString(Board& board) {
@@ -215,4 +299,39 @@ std::string algebraic(const Move& move, const std::array<Piece, 64>& position) {
     }
 
     return out;
-}
\ No newline at end of file
+}
+
+std::string uci(const Move& move) {
+    std::string out;
+    out += (char) (move.before%8 + 'a');
+    out += (char) (move.before/8 + '1');
+    out += (char) (move.after%8 + 'a');
+    out += (char) (move.after/8 + '1');
+
+    if (move.promotion) {
+        if (move.special1 && move.special0) out += 'q';
+        else if (move.special1 && !move.special0) out += 'r';
+        else if (!move.special1 && move.special0) out += 'b';
+        else out += 'n';
+    }
+
+    return out;
+}
+
+bool fromUCI(const std::string& text, const Board& board, Move& out) {
+    if (text.size() < 4 || text.size() > 5) return false;
+
+    const int before = (text[0] - 'a') + 8 * (text[1] - '1');
+    if (before < 0 || before >= 64) return false;
+
+    std::vector<Move> moves;
+    board.generateMoves(before, moves);
+
+    for (const Move& move : moves) {
+        if (uci(move) == text) {
+            out = move;
+            return true;
+        }
+    }
+    return false;
+}
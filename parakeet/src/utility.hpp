@@ -1,13 +1,24 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "board.hpp"
 
-static std::vector<std::string> split(std::string& text, const char& delimiter);
-static void logFENPosition(std::array<Piece, 64>& position);
+// Reads a FEN (or the first fields of an EPD record) into the board in a single pass, without allocating.
+// The board is left alone if the FEN can't be read; error then says why.
+bool loadFEN(std::string_view fen, Board& board, const char** error = nullptr);
+// Writes the position as a null terminated FEN (EPD without the clocks). Returns its length, 0 if size is too small.
+size_t writeFEN(const Board& board, char* buffer, const size_t size, const bool epd = false);
+std::string getFEN(const Board& board, const bool epd = false);
+// Prints how many positions per second loadFEN and writeFEN get through
+void benchFEN();
 
-void loadFEN(std::string fen, Board& board);
 std::string getPositionString(Board& board);
 std::string algebraic(const Move& move, const std::array<Piece, 64>& position);
+
+// UCI notation, e.g. e2e4, e7e8q, or e1g1 for castling
+std::string uci(const Move& move);
+// Finds the legal move in the position with the given UCI notation. Returns false if there is none.
+bool fromUCI(const std::string& text, const Board& board, Move& out);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "types/piece.hpp"
+
+namespace zobrist {
+    /* Keys are laid out like Polyglot's Random64 array:
+     * [0, 768)     64 * kind + square, where kind is 2 * piece + (white ? 1 : 0)
+     *              with pieces ordered pawn, knight, bishop, rook, queen, king
+     * [768, 772)   castling rights: white king-side, white queen-side, black king-side, black queen-side
+     * [772, 780)   en passant file (only when the side to move can actually capture)
+     * 780          white to move
+     */
+    constexpr int CASTLING_OFFSET   = 768;
+    constexpr int EN_PASSANT_OFFSET = 772;
+    constexpr int TURN_OFFSET       = 780;
+    constexpr int NUMBER_OF_KEYS    = 781;
+
+    extern const std::array<uint64_t, NUMBER_OF_KEYS> keys;
+
+    constexpr int pieceKind(const Piece& piece) {
+        int index = 0;
+        switch (piece.type) {
+            case PieceType::PAWN:   index = 0; break;
+            case PieceType::KNIGHT: index = 1; break;
+            case PieceType::BISHOP: index = 2; break;
+            case PieceType::ROOK:   index = 3; break;
+            case PieceType::QUEEN:  index = 4; break;
+            case PieceType::KING:   index = 5; break;
+            case PieceType::EMPTY:  return -1;
+        }
+        return 2*index + ((piece.side == Side::WHITE) ? 1 : 0);
+    }
+
+    inline uint64_t pieceKey(const Piece& piece, const int square) {
+        return keys[64*pieceKind(piece) + square];
+    }
+}